@@ -2,6 +2,7 @@
 #include <gflags/gflags.h>
 
 #include "runtime/configReaper.hpp"
+#include "runtime/benchmarkReaper.hpp"
 #include "utility.hpp"
 
 
@@ -16,6 +17,21 @@ using namespace Reaper;
 
 DEFINE_string(reaper_params, "../defaultParameters.json", "Load Parameters of Reaper via JSON file.");
 
+// 仅运行IPTrie插入与聚合的离线基准测试(使用Aggregator参数), 不启动DPDK运行时
+DEFINE_bool(bench_ip_trie, false, "Benchmark IPTrie insert/aggregate throughput and exit.");
+
+// 以float64为基线验证float32/int8推断的输出偏差(使用Detector参数), 不启动DPDK运行时
+DEFINE_bool(validate_precision, false, "Report detector output deviation of float32/int8 against float64 and exit.");
+
+// 对比detector的native预处理kernel与libtorch算子链(使用Detector参数), 不启动DPDK运行时
+DEFINE_bool(bench_preprocess, false, "Benchmark the native detector preprocessing kernel against the libtorch op chain and exit.");
+
+// 原生RNN后端与libtorch后端的一致性检查与性能对比(使用Detector参数), 不启动DPDK运行时
+DEFINE_bool(bench_backend, false, "Check parity of the native RNN backend against libtorch, compare their throughput/latency and exit.");
+
+// 流式推断与逐slice推断的偏差与性能对比(使用Detector参数), 不启动DPDK运行时
+DEFINE_bool(bench_streaming, false, "Compare stateful streaming inference against windowed inference (deviation, speed, incremental scoring) and exit.");
+
 
 int main(int argc, char** argv) {
     
@@ -37,6 +53,46 @@ int main(int argc, char** argv) {
     
     }
 
+    if (FLAGS_bench_ip_trie) {
+
+        benchmark_ip_trie(parameter_j.count("Aggregator") ? parameter_j["Aggregator"] : json::object());
+
+        return 0;
+
+    }
+
+    if (FLAGS_validate_precision) {
+
+        validate_detector_precision(parameter_j.count("Detector") ? parameter_j["Detector"] : json::object());
+
+        return 0;
+
+    }
+
+    if (FLAGS_bench_preprocess) {
+
+        benchmark_detector_preprocess(parameter_j.count("Detector") ? parameter_j["Detector"] : json::object());
+
+        return 0;
+
+    }
+
+    if (FLAGS_bench_backend) {
+
+        benchmark_detector_backend(parameter_j.count("Detector") ? parameter_j["Detector"] : json::object());
+
+        return 0;
+
+    }
+
+    if (FLAGS_bench_streaming) {
+
+        benchmark_detector_streaming(parameter_j.count("Detector") ? parameter_j["Detector"] : json::object());
+
+        return 0;
+
+    }
+
     const shared_ptr<ConfigReaper> p_reaper = make_shared<ConfigReaper>(parameter_j);
 
     p_reaper->enable_reaper();
@@ -13,31 +13,29 @@ static inline double_t __get_double_ts() {
 
 bool AggregatorWorkerThread::run(uint32_t coreId) {
 
-	if (p_inspector_vec.size() == 0) {
-
-        WARN("No Inspectors are Bound to Current Aggregator.");
-        
-        return false;
-
-    }
-
 	LOGF("Aggregator on Core #%d Start", coreId);
 
 	m_stop = false;
 	m_core_id = coreId;
 
-	unique_ptr<IPTrie > ip_trie;
-    ip_trie = make_unique<IPTrie >(p_aggregator_param->shortest_prefix_len, 
-                                   p_aggregator_param->aggr_len_th, 
-                                   p_aggregator_param->trunc_flow_len,
-                                   p_short_aggr_queue);
+	// arena并发度 = 1个master slot(聚合线程自身) + arena_cores上的worker线程
+	p_arena = make_unique<tbb::task_arena >(static_cast<int >(arena_core_set.size()) + 1, 1);
+	p_arena->initialize();
 
-    thread aggregator(&AggregatorWorkerThread::aggregator_exec, this);
-    aggregator.detach();
+	if (!arena_core_set.empty()) {
 
-    pair<FlowID, FlowEntry > short_flow;
+		p_arena_observer = make_unique<CorePinningObserver >(*p_arena, arena_core_set);
+
+	}
+
+	unique_ptr<IPTrie > ip_trie = acquire_ip_trie();
+
+    aggr_exec_thread = thread(&AggregatorWorkerThread::aggregator_exec, this);
+
+    pair<uint32_t, FlowDataStats > short_flow;
 
     uint32_t aggr_flow_num = 0;
+    double_t cycle_start_ts = 0;
 
     double_t last_ts = __get_double_ts();
 
@@ -58,60 +56,42 @@ bool AggregatorWorkerThread::run(uint32_t coreId) {
                 create_throughput.push_back(curr_throughput);
 
                 LOGF("Aggregator (Creating) on Core #%d: [ %4.5lf Gbps ]", m_core_id, curr_throughput);
+                p_short_flow_queue->display_stats("short_flow_queue");
+                ip_trie_queue.display_stats("ip_trie_queue");
+                p_short_aggr_queue->display_stats("short_aggr_queue");
 
             }
 
             last_ts = curr_ts;
         }
 
-        for (size_t i = 0; i < p_inspector_vec.size(); i ++) {
+        if (p_short_flow_queue->try_pop(short_flow)) {
 
-            if (p_inspector_vec[i]->short_flow_queue.try_pop(short_flow)) {
-
-            	if (short_flow.second.forward_init) { 
-                
-	                double_t round_start_ts = __get_double_ts();
-
-	                ip_trie->insert(short_flow.first.low_ip, short_flow.second.dirs[1]); 
-	                
-	                double_t round_end_ts = __get_double_ts();
-
-	                sum_create_pkt_len += short_flow.second.dirs[1].vol;
-	                create_active_time += (round_end_ts - round_start_ts);
-	                
-	                aggr_flow_num ++; 
-	            
-	            }
+            double_t round_start_ts = __get_double_ts();
 
-	            if (short_flow.second.backward_init) { 
+            if (aggr_flow_num == 0) cycle_start_ts = round_start_ts;
 
-	                double_t round_start_ts = __get_double_ts();
-	                
-	                ip_trie->insert(short_flow.first.high_ip, short_flow.second.dirs[2]); 
+            ip_trie->insert(short_flow.first, short_flow.second); 
 
-	                double_t round_end_ts = __get_double_ts();
+            double_t round_end_ts = __get_double_ts();
 
-	                sum_create_pkt_len += short_flow.second.dirs[2].vol;
-	                create_active_time += (round_end_ts - round_start_ts);
+            sum_create_pkt_len += short_flow.second.vol;
+            create_active_time += (round_end_ts - round_start_ts);
 
-	                aggr_flow_num ++; 
-	                
-	            }
-	            
-	            if (aggr_flow_num >= p_aggregator_param->aggr_cycle) { // aggr_flow_num每次变化1或者2, 有可能会不等于aggr_cycle
-	           
-	                ip_trie_queue.push(move(ip_trie));
-	        
-	                ip_trie = make_unique<IPTrie >(p_aggregator_param->shortest_prefix_len, 
-	                                   p_aggregator_param->aggr_len_th, 
-                                       p_aggregator_param->trunc_flow_len,
-	                                   p_short_aggr_queue);
+            aggr_flow_num ++; 
 
-	                aggr_flow_num = 0;
+        }
 
-	            }
+        // 按数量或者按时间结束当前周期, 低速流量下也能在aggr_cycle_timeout内交给aggregator_exec
+        if (aggr_flow_num >= p_aggregator_param->aggr_cycle || 
+                (aggr_flow_num > 0 && p_aggregator_param->aggr_cycle_timeout > 0 && curr_ts - cycle_start_ts >= p_aggregator_param->aggr_cycle_timeout)) {
+       
+            ip_trie_queue.push(move(ip_trie));
+            aggr_notifier.notify();
+    
+            ip_trie = acquire_ip_trie();
 
-            }
+            aggr_flow_num = 0;
 
         }
 
@@ -124,9 +104,28 @@ bool AggregatorWorkerThread::run(uint32_t coreId) {
 
 void AggregatorWorkerThread::aggregator_exec() {
 
+    if (exec_core >= 0) {
+
+        if (pin_current_thread(static_cast<cpu_core_id_t >(exec_core))) LOGF("Aggregator (Aggregating) of Core #%d is Pinned to Core #%d", m_core_id, exec_core);
+        else WARN("Fail to Pin Aggregating Thread to Specified Core.");
+
+    }
+
     unique_ptr<IPTrie > ip_trie;
 
-    uint32_t round = 0;
+    unique_ptr<IPTrie > p_incremental_trie;
+    double_t last_incremental_ts = __get_double_ts();
+
+    if (p_aggregator_param->incremental_aggr) {
+
+        p_incremental_trie = make_unique<IPTrie >(p_aggregator_param->shortest_prefix_len, 
+                                                  p_aggregator_param->aggr_len_th, 
+                                                  p_aggregator_param->trunc_flow_len,
+                                                  p_short_aggr_queue, &m_stop);
+
+        p_incremental_trie->reserve(p_aggregator_param->aggr_cycle);
+
+    }
 
     double_t last_ts = __get_double_ts();
 
@@ -154,20 +153,53 @@ void AggregatorWorkerThread::aggregator_exec() {
 
         }
 
-        if (ip_trie_queue.try_pop(ip_trie)) { 
+        bool drained = false;
+
+        // 每次唤醒时取空ip_trie_queue
+        while (ip_trie_queue.try_pop(ip_trie)) { 
             
             double_t round_start_ts = __get_double_ts();
 
-            uint32_t aggr_pkt_len = ip_trie->aggregate();
+            uint64_t aggr_pkt_len;
+
+            if (p_incremental_trie) {
+
+                // 新周期的流并入长期存在的IPTrie, 只重新聚合有变化的bound prefix
+                p_incremental_trie->absorb(*ip_trie, round_start_ts);
+                aggr_pkt_len = p_incremental_trie->aggregate_incremental(round_start_ts, p_aggregator_param->aggr_prefix_ttl, p_arena.get());
+
+                last_incremental_ts = round_start_ts;
+
+            } else {
+
+                aggr_pkt_len = ip_trie->aggregate(p_arena.get());
+
+            }
 
             double_t round_end_ts = __get_double_ts();
 
             sum_aggr_pkt_len += aggr_pkt_len;
             aggr_active_time += (round_end_ts - round_start_ts);
 
+            // 整棵Trie的释放只是一次arena清空
+            ip_trie->reset();
+            recycled_ip_trie_queue.push(move(ip_trie));
+
+            drained = true;
+
         }
+        
+        if (!drained && p_incremental_trie && curr_ts - last_incremental_ts >= min(1.0, p_aggregator_param->aggr_prefix_ttl)) {
 
-        usleep(50000);
+            // 没有新周期时也需要定期老化bound prefix
+            sum_aggr_pkt_len += p_incremental_trie->aggregate_incremental(curr_ts, p_aggregator_param->aggr_prefix_ttl, p_arena.get());
+
+            last_incremental_ts = curr_ts;
+
+        }
+
+        // 队列已空, 阻塞等待创建线程的通知; 超时用于定期报告, 老化与检查m_stop
+        aggr_notifier.wait(AGGR_EXEC_WAIT_MS);
 
     }    
 
@@ -175,11 +207,33 @@ void AggregatorWorkerThread::aggregator_exec() {
 
 
 
+unique_ptr<IPTrie > AggregatorWorkerThread::acquire_ip_trie() {
+
+    unique_ptr<IPTrie > ip_trie;
+
+    if (recycled_ip_trie_queue.try_pop(ip_trie)) return ip_trie;
+
+    ip_trie = make_unique<IPTrie >(p_aggregator_param->shortest_prefix_len, 
+                                   p_aggregator_param->aggr_len_th, 
+                                   p_aggregator_param->trunc_flow_len,
+                                   p_short_aggr_queue, &m_stop);
+
+    ip_trie->reserve(p_aggregator_param->aggr_cycle);
+
+    return ip_trie;
+
+}
+
 void AggregatorWorkerThread::stop() {
 
 	LOGF("Aggregator on Core #%d Stop", m_core_id);
 	
 	m_stop = true;
+
+	// 唤醒并等待聚合线程退出
+	aggr_notifier.notify();
+
+	if (aggr_exec_thread.joinable()) aggr_exec_thread.join();
 	
 }
 
@@ -257,7 +311,24 @@ void AggregatorWorkerThread::load_params_via_json(const json &jin) {
         } else {
             FATAL_ERROR("Parameter(aggr_cycle) is Missing!");
         }
-    
+
+        if (jin.count("aggr_cycle_timeout")) p_aggregator_param->aggr_cycle_timeout = static_cast<double_t >(jin["aggr_cycle_timeout"]);
+        if (jin.count("incremental_aggr")) p_aggregator_param->incremental_aggr = jin["incremental_aggr"];
+        if (jin.count("aggr_prefix_ttl")) p_aggregator_param->aggr_prefix_ttl = static_cast<double_t >(jin["aggr_prefix_ttl"]);
+
+        if (jin.count("exec_cores")) {
+            const vector<int> & core_vec = jin["exec_cores"];
+            p_aggregator_param->exec_cores.assign(core_vec.cbegin(), core_vec.cend());
+        }
+
+        if (jin.count("arena_cores")) {
+            const vector<int> & core_vec = jin["arena_cores"];
+            p_aggregator_param->arena_cores.assign(core_vec.cbegin(), core_vec.cend());
+        }
+
+        if (jin.count("short_flow_queue")) p_aggregator_param->short_flow_queue_param.load_params_via_json(jin["short_flow_queue"]);
+        if (jin.count("ip_trie_queue")) p_aggregator_param->ip_trie_queue_param.load_params_via_json(jin["ip_trie_queue"]);
+        if (jin.count("short_aggr_queue")) p_aggregator_param->short_aggr_queue_param.load_params_via_json(jin["short_aggr_queue"]);
     
     } catch (exception & e) {
 
@@ -265,6 +336,11 @@ void AggregatorWorkerThread::load_params_via_json(const json &jin) {
     
     }
 
+    // 生产者为多个inspectors, BLOCK策略下以消费者(当前aggregator)的终止标记作为放弃等待的条件
+    p_short_flow_queue->configure(p_aggregator_param->short_flow_queue_param, &m_stop);
+    ip_trie_queue.configure(p_aggregator_param->ip_trie_queue_param, &m_stop);
+    p_short_aggr_queue->configure(p_aggregator_param->short_aggr_queue_param, &m_stop);
+
 	return;
 
 }
\ No newline at end of file
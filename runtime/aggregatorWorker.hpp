@@ -23,8 +23,29 @@ struct AggregatorThreadParam final {
     uint32_t aggr_len_th = 5e2;
     uint32_t aggr_cycle = 1e4;
 
+    // 周期的时间上限(秒): 距离当前IPTrie的第一条流超过该时间即结束周期, 0表示只按aggr_cycle计数
+    double_t aggr_cycle_timeout = 1.0;
+
+    // 增量聚合: 保留一棵长期存在的IPTrie, 每个周期只重新聚合有变化的bound prefix
+    // 超过aggr_prefix_ttl秒没有新流的bound prefix发送剩余数据后删除
+    bool incremental_aggr = false;
+    double_t aggr_prefix_ttl = 60;
+
     uint32_t trunc_flow_len = 1e3;
 
+    // TBB worker threads of the aggregation arenas are pinned to these cores, split evenly among aggregators
+    // (empty -> aggregation runs serially on the aggregating thread)
+    vector<cpu_core_id_t > arena_cores;
+
+    // 每个aggregator的聚合线程(aggregator_exec)各绑定一个核心, 为空时不绑定
+    vector<cpu_core_id_t > exec_cores;
+
+    // 所有inspectors写入当前aggregator的短流队列
+    BoundedQueueParam short_flow_queue_param = BoundedQueueParam(1 << 20, OverloadPolicy::SHED_NEWEST);
+    // 一棵IPTrie占用内存较大, 默认阻塞创建线程, 由short_flow_queue承担丢弃
+    BoundedQueueParam ip_trie_queue_param = BoundedQueueParam(16, OverloadPolicy::BLOCK);
+    BoundedQueueParam short_aggr_queue_param = BoundedQueueParam(1 << 16, OverloadPolicy::SHED_NEWEST);
+
     void inline display_params() const {
 
         printf("[ ***AggregatorThreadParam*** ]\n");
@@ -36,7 +57,30 @@ struct AggregatorThreadParam final {
 
         printf("Shortest IP Prefix Length: %d.\n", shortest_prefix_len);
         printf("Aggregation Flow Length Threshold: %d.\n", aggr_len_th);
-        printf("Aggregation Cycle: %d.\n", aggr_cycle);
+        printf("Aggregation Cycle: %d Flows", aggr_cycle);
+        if (aggr_cycle_timeout > 0) printf(" or %4.4lf s", aggr_cycle_timeout);
+        printf(".\n");
+
+        if (incremental_aggr) printf("Incremental Aggregation is Up, Prefix TTL: %4.4lf s.\n", aggr_prefix_ttl);
+        else printf("Incremental Aggregation is Down.\n");
+
+        if (arena_cores.empty()) printf("Aggregation Arena is Inline (No TBB Worker Threads).\n");
+        else {
+            printf("Aggregation Arena is Pinned to Cores:");
+            for (const auto & _core : arena_cores) printf(" %d", _core);
+            printf(".\n");
+        }
+
+        if (exec_cores.empty()) printf("Aggregating Threads are Not Pinned.\n");
+        else {
+            printf("Aggregating Threads are Pinned to Cores:");
+            for (const auto & _core : exec_cores) printf(" %d", _core);
+            printf(".\n");
+        }
+
+        short_flow_queue_param.display_params("short_flow_queue");
+        ip_trie_queue_param.display_params("ip_trie_queue");
+        short_aggr_queue_param.display_params("short_aggr_queue");
 
     }
 
@@ -55,36 +99,60 @@ private:
 
     shared_ptr<AggregatorThreadParam > p_aggregator_param;
 
-    uint32_t sum_create_pkt_len = 0;
+    uint64_t sum_create_pkt_len = 0;
     vector<double_t > create_throughput;
     double_t create_active_time;
 
-    uint32_t sum_aggr_pkt_len = 0;
+    uint64_t sum_aggr_pkt_len = 0;
     vector<double_t > aggr_throughput;
     double_t aggr_active_time;
 
     // inspector <-> aggregator
-    // 与aggregator关联的一系列inspectors, visit their short_flow_queue
-    vector<shared_ptr<InspectorWorkerThread > > p_inspector_vec;
+    // 当前aggregator负责的bound prefix分区的短流, 由ConfigReaper分发给所有inspectors
+    shared_ptr<ShortFlowQueue > p_short_flow_queue;
+
+    BoundedQueue<unique_ptr<IPTrie > > ip_trie_queue;
 
-    tbb::concurrent_queue<unique_ptr<IPTrie > > ip_trie_queue;
+    // 聚合完成并reset()后的IPTrie, 其arena由创建线程复用
+    tbb::concurrent_queue<unique_ptr<IPTrie > > recycled_ip_trie_queue;
+
+    unique_ptr<IPTrie > acquire_ip_trie();
+
+    // 按bound prefix并行聚合所使用的task_arena, worker线程绑定至arena_core_set
+    unique_ptr<tbb::task_arena > p_arena;
+    unique_ptr<CorePinningObserver > p_arena_observer;
 
     // aggregator <-> detector
-    shared_ptr<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > > p_short_aggr_queue;
+    shared_ptr<PktMetaDataArrayOutputQueue > p_short_aggr_queue;
+
+    // 聚合线程: 由创建线程(DPDK lcore)在run()中启动, stop()时回收
+    // ip_trie_queue为空时阻塞在aggr_notifier上, 创建线程每交出一棵IPTrie通知一次
+    thread aggr_exec_thread;
+    EventNotifier aggr_notifier;
+
+    static const int AGGR_EXEC_WAIT_MS = 100;
+
+    // 本aggregator的arena worker线程可用的核心, 由ConfigReaper从arena_cores中划分
+    vector<cpu_core_id_t > arena_core_set;
+
+    // 聚合线程绑定的核心, 由ConfigReaper按exec_cores分配, -1表示不绑定
+    int exec_core = -1;
 
     void aggregator_exec();
 
 public:
 
-    AggregatorWorkerThread(const vector<shared_ptr<InspectorWorkerThread > > & _pv): p_inspector_vec(_pv) {
+    AggregatorWorkerThread() {
 
-        p_short_aggr_queue = make_shared<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > >();
+        p_short_flow_queue = make_shared<ShortFlowQueue >();
+        p_short_aggr_queue = make_shared<PktMetaDataArrayOutputQueue >();
 
     }
 
-    AggregatorWorkerThread(const vector<shared_ptr<InspectorWorkerThread > > & _pv, const json & _j): p_inspector_vec(_pv) {
+    explicit AggregatorWorkerThread(const json & _j) {
 
-        p_short_aggr_queue = make_shared<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > >();
+        p_short_flow_queue = make_shared<ShortFlowQueue >();
+        p_short_aggr_queue = make_shared<PktMetaDataArrayOutputQueue >();
         
         load_params_via_json(_j);
 
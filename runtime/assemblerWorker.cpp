@@ -70,6 +70,8 @@ bool AssemblerWorkerThread::run(uint32_t coreId) {
 
                 LOGF("Assembler (Fetching) on Core #%d: [ %4.5lf Gbps ]", m_core_id, curr_fetch_throughput);
                 LOGF("Assembler (Updateing) on Core #%d: [ %4.5lf Gbps ]", m_core_id, curr_update_throughput);
+                last_pool_queue.display_stats("last_pool_queue");
+                LOGF("Assembler on Core #%d: %ld Flows Emitted Early, %ld Streaming Chunks", m_core_id, early_emitted_num, stream_chunk_num);
 
             }
 
@@ -123,8 +125,7 @@ void AssemblerWorkerThread::update_flow_tbl() {
         
         if (curr_ts - last_enqueue_ts > p_assembler_param->pause_time) {
 
-            last_pool_queue.push(move(next_pool));
-            snapshot_ts_queue.push(curr_ts);
+            last_pool_queue.push({move(next_pool), curr_ts});
 
             next_pool = make_unique<vector<FlowID > >();
 
@@ -222,6 +223,71 @@ void AssemblerWorkerThread::update_flow_tbl() {
 
             }
 
+            // 流式分段: 按当前的统计分类, 长流把已有的包发送给负责该流的detector; 
+            // 首段之前把缓冲区预留至trunc_flow_len, 之后的追加不会移动detector正在读取的数据
+            const uint32_t _chunk_len = p_assembler_param->stream_chunk_len;
+
+            if (_chunk_len && !p_stream_queue_vec.empty() && p_flow_classifier && 
+                    acc->second.dirs[0].len < p_assembler_param->trunc_flow_len && acc->second.dirs[0].len % _chunk_len == 0) {
+
+                const FlowClassRule & rule = p_flow_classifier->get_rule(p_flow_classifier->classify(_id, acc->second.dirs[0]));
+
+                if (rule.dest == FlowDestination::LONG) {
+
+                    acc->second.dirs[0].p_flat_vec->reserve(static_cast<size_t >(p_assembler_param->trunc_flow_len) * 3);
+
+                    if (push_stream_chunk(p_stream_queue_vec, _id, acc->second.dirs[0], rule.model, false, &m_stop)) {
+
+                        acc->second.streamed = true;
+
+                        stream_chunk_num ++;
+
+                    }
+
+                }
+
+            }
+
+            // 特征缓冲区刚刚写满: 立即发送快照(或按分类表丢弃), 释放缓冲区, 流表中只保留计数
+            // 发送失败(队列丢弃)或分类为短流时保留缓冲区, 由inspector在流过期时照常处理
+            if (p_assembler_param->early_emission && p_long_queue && p_flow_classifier && acc->second.dirs[0].len == p_assembler_param->trunc_flow_len) {
+
+                const size_t class_id = p_flow_classifier->classify(_id, acc->second.dirs[0]);
+                const FlowClassRule & rule = p_flow_classifier->get_rule(class_id);
+
+                bool handled = false;
+
+                if (rule.dest == FlowDestination::DROP) {
+
+                    handled = true;
+
+                } else if (rule.dest == FlowDestination::LONG && acc->second.streamed) {
+
+                    // 已分段发送的流, 最后一段交给同一个detector
+                    handled = push_stream_chunk(p_stream_queue_vec, _id, acc->second.dirs[0], rule.model, true, &m_stop);
+
+                } else if (rule.dest == FlowDestination::LONG) {
+
+                    shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(acc->second.dirs[0].p_flat_vec, acc->second.dirs[0].vol, rule.model, mts_key_of(_id));
+
+                    handled = p_long_queue->push(p0, flow_class_of(_id), &m_stop);
+
+                }
+
+                if (handled) {
+
+                    p_flow_classifier->record(class_id, acc->second.dirs[0].vol);
+
+                    acc->second.early_emitted = true;
+
+                    for (auto & _dir : acc->second.dirs) _dir.p_flat_vec.reset();
+
+                    early_emitted_num ++;
+
+                }
+
+            }
+
             if (forward_direction) {
 
                 if (!acc->second.forward_init) { acc->second.forward_init = true; }
@@ -409,6 +475,16 @@ void AssemblerWorkerThread::load_params_via_json(const json & jin) {
         } else {
             FATAL_ERROR("Parameter(trunc_flow_len) is Missing!");
         }
+
+        if (jin.count("early_emission")) {
+            p_assembler_param->early_emission = jin["early_emission"];
+        }
+
+        if (jin.count("stream_chunk_len")) {
+            p_assembler_param->stream_chunk_len = static_cast<decltype(p_assembler_param->stream_chunk_len)>(jin["stream_chunk_len"]);
+        }
+
+        if (jin.count("last_pool_queue")) p_assembler_param->last_pool_queue_param.load_params_via_json(jin["last_pool_queue"]);
     
     } catch (exception & e) {
 
@@ -416,6 +492,8 @@ void AssemblerWorkerThread::load_params_via_json(const json & jin) {
     
     }
 
+    last_pool_queue.configure(p_assembler_param->last_pool_queue_param, &m_stop);
+
     return;
 
 }
\ No newline at end of file
@@ -24,6 +24,16 @@ struct AssemblerThreadParam final {
 
     uint32_t trunc_flow_len = 1e3;
 
+    // 流的特征缓冲区写满(达到trunc_flow_len)后立即发送给detector, 不再等待流过期
+    bool early_emission = true;
+
+    // 流式分段: 分类为长流的流每到达stream_chunk_len个包, 把已有的包作为一段发送给负责该流的detector增量评分, 0表示关闭
+    // 需要Detector.streaming_inference, 通常取slice步长的整数倍
+    uint32_t stream_chunk_len = 0;
+
+    // 丢弃ID池会使对应的流永远不被检查, 默认阻塞assembler
+    BoundedQueueParam last_pool_queue_param = BoundedQueueParam(1 << 12, OverloadPolicy::BLOCK);
+
 
     void inline display_params() const {
 
@@ -36,6 +46,11 @@ struct AssemblerThreadParam final {
         printf("Packet Meta Buffer Size: %ld.\n", pkt_meta_buffer_size);
         printf("Maximum Fetch from Buffer at One Time: %ld.\n", max_fetch);
         printf("Truncation Length for Flow: %d.\n", trunc_flow_len);
+        if (early_emission) printf("Early Emission of Truncated Flows is Up.\n");
+        else printf("Early Emission of Truncated Flows is Down.\n");
+        if (stream_chunk_len) printf("Streaming Chunks of Long Flows: Every %d Packets.\n", stream_chunk_len);
+        else printf("Streaming Chunks of Long Flows is Down.\n");
+        last_pool_queue_param.display_params("last_pool_queue");
 
 
     }
@@ -75,9 +90,23 @@ private:
     unique_ptr<vector<FlowID > > next_pool;
     uint64_t last_enqueue_ts;
 
+    // assembler <-> detector, 与本地inspector共用 (set by ConfigReaper)
+    shared_ptr<PktMetaDataArrayOutputQueue > p_long_queue;
+    shared_ptr<FlowClassifier > p_flow_classifier;
+    uint64_t early_emitted_num = 0;
+
+    // assembler -> detectors, 每个detector一个流式分段队列, 按流划分 (set by ConfigReaper)
+    vector<shared_ptr<PktMetaDataArrayOutputQueue > > p_stream_queue_vec;
+    uint64_t stream_chunk_num = 0;
+
     // main <-> inspector
-    tbb::concurrent_queue<unique_ptr<vector<FlowID > > > last_pool_queue;
-    tbb::concurrent_queue<uint64_t > snapshot_ts_queue;
+    // 新流ID池与其快照时间戳成对入队, 避免inspector只取到其中之一
+    BoundedQueue<pair<unique_ptr<vector<FlowID > >, uint64_t > > last_pool_queue;
+
+    // per-assembler expiry state, 由当前持有inspecting标记的inspector独占访问
+    // 任意inspector都可以认领该assembler的一轮检查(work-stealing)
+    unique_ptr<tbb::concurrent_unordered_set<FlowID, FlowIDHash > > historical_pool;
+    atomic<bool > inspecting{false};
 
 
     size_t fetch_from_parser(const shared_ptr<ParserWorkerThread > pt) const;
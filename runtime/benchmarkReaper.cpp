@@ -0,0 +1,589 @@
+#include "benchmarkReaper.hpp"
+#include "detectorWorker.hpp"
+
+#include <random>
+
+using namespace Reaper;
+
+static inline double_t __get_double_ts() {
+
+    struct timeval ts;
+    gettimeofday(&ts, nullptr);
+    return ts.tv_sec + ts.tv_usec*(1e-6);
+
+}
+
+// 合成的短流: 按bound prefix聚集的IP, 长度为[1, max_len]个数据包, 时间戳递增
+static void generate_short_flows(vector<pair<uint32_t, FlowDataStats > > & flow_vec, 
+                                 const size_t flow_num, const uint32_t bound_prefix_len, const uint32_t max_len) {
+
+    mt19937 rng(flow_num);
+
+    // 每个bound prefix下平均约256条流
+    const size_t prefix_num = max(static_cast<size_t >(1), flow_num >> 8);
+    const uint32_t bound_prefix_mask = bound_prefix_len == 0 ? 0 : ~uint32_t(0) << (32 - bound_prefix_len);
+
+    vector<uint32_t > prefix_vec(prefix_num);
+    for (auto & _p : prefix_vec) _p = rng() & bound_prefix_mask;
+
+    uniform_int_distribution<uint32_t > len_dist(1, max_len);
+    uniform_int_distribution<uint64_t > pkt_len_dist(64, 1500);
+    uniform_int_distribution<uint64_t > interval_dist(1, 100000);
+
+    flow_vec.clear();
+    flow_vec.reserve(flow_num);
+
+    for (size_t i = 0; i < flow_num; i ++) {
+
+        const uint32_t ip = prefix_vec[rng() % prefix_num] | (rng() & ~bound_prefix_mask);
+
+        FlowDataStats _stats;
+        _stats.len = len_dist(rng);
+        _stats.p_flat_vec->reserve(_stats.len * 3);
+
+        uint64_t _ts = rng();
+
+        for (uint32_t k = 0; k < _stats.len; k ++) {
+
+            const uint64_t _pkt_len = pkt_len_dist(rng);
+
+            _ts += interval_dist(rng);
+
+            _stats.p_flat_vec->push_back(_ts);
+            _stats.p_flat_vec->push_back(_pkt_len);
+            _stats.p_flat_vec->push_back(rng() & 1);
+
+            _stats.vol += _pkt_len;
+
+        }
+
+        flow_vec.emplace_back(ip, move(_stats));
+
+    }
+
+}
+
+void Reaper::benchmark_ip_trie(const json & jin) {
+
+    uint32_t shortest_prefix_len = jin.count("shortest_prefix_len") ? static_cast<uint32_t >(jin["shortest_prefix_len"]) : 24;
+    uint64_t aggr_len_th = jin.count("aggr_len_th") ? static_cast<uint64_t >(jin["aggr_len_th"]) : 500;
+    uint32_t trunc_flow_len = jin.count("trunc_flow_len") ? static_cast<uint32_t >(jin["trunc_flow_len"]) : 1000;
+
+    const uint32_t rounds = 5;
+
+    // 并行聚合的arena: 与Aggregator相同, 1个master slot + arena_cores个worker; arena_cores为空时使用全部硬件线程
+    int arena_concurrency = tbb::this_task_arena::max_concurrency();
+
+    if (jin.count("arena_cores") && !jin["arena_cores"].empty()) arena_concurrency = static_cast<int >(jin["arena_cores"].size()) + 1;
+
+    tbb::task_arena arena(arena_concurrency, 1);
+
+    LOGF("IPTrie Benchmark: Shortest Prefix Length: %d, Aggregation Threshold: %ld, Truncation Length: %d, %d Rounds per Cycle Size, Arena Concurrency: %d.", 
+            shortest_prefix_len, aggr_len_th, trunc_flow_len, rounds, arena_concurrency);
+
+    for (size_t flow_num : {10000, 100000, 1000000}) {
+
+        vector<pair<uint32_t, FlowDataStats > > flow_vec;
+        generate_short_flows(flow_vec, flow_num, shortest_prefix_len, 39);
+
+        shared_ptr<PktMetaDataArrayOutputQueue > p_output = make_shared<PktMetaDataArrayOutputQueue >();
+        p_output->configure(BoundedQueueParam(flow_num * 2, OverloadPolicy::SHED_NEWEST), nullptr);
+
+        IPTrie ip_trie(shortest_prefix_len, aggr_len_th, trunc_flow_len, p_output);
+        ip_trie.reserve(flow_num);
+
+        // 先串行(p_arena为空)再并行, 两者的输出应当相同
+        for (tbb::task_arena * p_arena : {static_cast<tbb::task_arena * >(nullptr), &arena}) {
+
+            double_t insert_time = 0, aggr_time = 0;
+            uint64_t aggr_vol = 0, output_num = 0;
+            size_t node_num = 0;
+
+            for (uint32_t r = 0; r < rounds; r ++) {
+
+                double_t insert_start_ts = __get_double_ts();
+
+                for (const auto & _flow : flow_vec) ip_trie.insert(_flow.first, _flow.second);
+
+                double_t insert_end_ts = __get_double_ts();
+
+                node_num = ip_trie.node_num();
+
+                double_t aggr_start_ts = __get_double_ts();
+
+                aggr_vol += ip_trie.aggregate(p_arena);
+
+                double_t aggr_end_ts = __get_double_ts();
+
+                ip_trie.reset();
+
+                insert_time += (insert_end_ts - insert_start_ts);
+                aggr_time += (aggr_end_ts - aggr_start_ts);
+
+                shared_ptr<PktMetaDataArrayOutput > p_mts;
+                while (p_output->try_pop(p_mts)) output_num ++;
+
+            }
+
+            printf("[IPTrie Benchmark] %7ld Flows/Cycle -> Insert: %8.3lf Mflows/s (%7.3lf ms), Aggregate(%s): %8.3lf Mflows/s (%7.3lf ms, %7.3lf Gbps), Nodes: %ld, Outputs/Cycle: %ld\n", 
+                    flow_num, 
+                    flow_num * rounds / insert_time / 1e6, insert_time / rounds * 1e3, 
+                    p_arena ? "Parallel" : "Serial",
+                    flow_num * rounds / aggr_time / 1e6, aggr_time / rounds * 1e3, aggr_vol * 8.0 / aggr_time / 1e9,
+                    node_num, output_num / rounds);
+
+        }
+
+    }
+
+}
+
+
+// 合成的长流: {ts(ns), pkt_len, type}, 长度为[min_len, max_len]个数据包
+static void generate_long_flows(vector<PktMetaDataArray > & flow_vec, const size_t flow_num, const uint32_t min_len, const uint32_t max_len) {
+
+    mt19937 rng(flow_num);
+
+    uniform_int_distribution<uint32_t > len_dist(min_len, max_len);
+    uniform_int_distribution<uint64_t > pkt_len_dist(64, 1500);
+    exponential_distribution<double_t > interval_dist(1e-5);
+
+    flow_vec.assign(flow_num, PktMetaDataArray());
+
+    for (auto & _flat : flow_vec) {
+
+        const uint32_t _len = len_dist(rng);
+        _flat.reserve(_len * 3);
+
+        uint64_t _ts = 1600000000ull * 1000000000ull + rng();
+
+        for (uint32_t k = 0; k < _len; k ++) {
+
+            _ts += static_cast<uint64_t >(interval_dist(rng)) + 1;
+
+            _flat.push_back(_ts);
+            _flat.push_back(pkt_len_dist(rng));
+            _flat.push_back(rng() % 3);
+
+        }
+
+    }
+
+}
+
+void Reaper::validate_detector_precision(const json & jin) {
+
+    const size_t flow_num = 1000;
+
+    DetectorThreadParam _param;
+    const uint32_t slice_len = jin.count("slice_len") ? static_cast<uint32_t >(jin["slice_len"]) : _param.slice_len;
+    const uint32_t trunc_flow_len = jin.count("trunc_flow_len") ? static_cast<uint32_t >(jin["trunc_flow_len"]) : _param.trunc_flow_len;
+
+    vector<PktMetaDataArray > flow_vec;
+    generate_long_flows(flow_vec, flow_num, slice_len, max(slice_len, trunc_flow_len));
+
+    // 对全部合成流做预处理与推断, 输出统一转换为float64以便比较
+    auto infer_all = [&flow_vec] (DetectorWorkerThread & detector, const bool use_aggr_model, 
+                                    vector<torch::Tensor > & outputs, double_t & pre_time, double_t & inference_time) {
+
+        torch::NoGradGuard no_grad;
+        DetectorBackend & backend = use_aggr_model ? *detector.p_aggr_backend : *detector.p_long_backend;
+
+        outputs.clear();
+        pre_time = inference_time = 0;
+
+        for (const auto & _flat : flow_vec) {
+
+            double_t pre_start_ts = __get_double_ts();
+            torch::Tensor slices = detector.preprocess(_flat, use_aggr_model);
+            double_t pre_end_ts = __get_double_ts();
+
+            torch::Tensor out = backend.forward(slices);
+            double_t inference_end_ts = __get_double_ts();
+
+            pre_time += (pre_end_ts - pre_start_ts);
+            inference_time += (inference_end_ts - pre_end_ts);
+
+            outputs.push_back(out.to(torch::kFloat64));
+
+        }
+
+    };
+
+    json j_base = jin;
+    j_base["precision"] = "float64";
+
+    ModelRegistry registry;
+
+    DetectorWorkerThread baseline({}, {}, j_base);
+    baseline.load_models(registry);
+    baseline.prepare_buffers();
+
+    LOGF("Precision Validation: %ld Synthetic Flows, Slice Length: %d, Truncation Length: %d, Baseline Model: %s.", 
+            flow_num, slice_len, trunc_flow_len, baseline.p_detector_param->long_model_path.c_str());
+
+    for (const bool use_aggr_model : {false, true}) {
+
+        vector<torch::Tensor > base_outputs;
+        double_t base_pre_time, base_inference_time;
+
+        infer_all(baseline, use_aggr_model, base_outputs, base_pre_time, base_inference_time);
+
+        printf("[Precision Validation] %s Model, float64 -> Preprocess: %7.3lf us/flow, Inference: %7.3lf us/flow\n", 
+                use_aggr_model ? "Aggr" : "Long", base_pre_time / flow_num * 1e6, base_inference_time / flow_num * 1e6);
+
+        for (const string _precision : {"float32", "int8"}) {
+
+            json j_target = jin;
+            j_target["precision"] = _precision;
+
+            DetectorWorkerThread target({}, {}, j_target);
+
+            const string & _path = use_aggr_model ? target.p_detector_param->aggr_model_path : target.p_detector_param->long_model_path;
+            if (!ifstream(_path).good()) {
+                WARNF("Skip %s Validation: Model %s Not Found.", _precision.c_str(), _path.c_str());
+                continue;
+            }
+
+            target.load_models(registry);
+            target.prepare_buffers();
+
+            vector<torch::Tensor > outputs;
+            double_t pre_time, inference_time;
+
+            infer_all(target, use_aggr_model, outputs, pre_time, inference_time);
+
+            // 逐元素的绝对偏差, 以及相对基线输出平均幅值的偏差
+            double_t max_abs_dev = 0, sum_abs_dev = 0, sum_abs_base = 0;
+            size_t elem_num = 0;
+
+            for (size_t i = 0; i < flow_num; i ++) {
+
+                torch::Tensor _dev = (outputs[i] - base_outputs[i]).abs();
+
+                max_abs_dev = max(max_abs_dev, _dev.max().item<double_t >());
+                sum_abs_dev += _dev.sum().item<double_t >();
+                sum_abs_base += base_outputs[i].abs().sum().item<double_t >();
+                elem_num += _dev.numel();
+
+            }
+
+            printf("[Precision Validation] %s Model, %7s -> Preprocess: %7.3lf us/flow, Inference: %7.3lf us/flow, Max Abs Dev: %.3e, Mean Abs Dev: %.3e, Rel Dev: %.3e\n", 
+                    use_aggr_model ? "Aggr" : "Long", _precision.c_str(), 
+                    pre_time / flow_num * 1e6, inference_time / flow_num * 1e6,
+                    max_abs_dev, sum_abs_dev / max(elem_num, static_cast<size_t >(1)), 
+                    sum_abs_base > 0 ? sum_abs_dev / sum_abs_base : 0.0);
+
+        }
+
+    }
+
+}
+
+void Reaper::benchmark_detector_preprocess(const json & jin) {
+
+    const size_t flow_num = 10000;
+    const uint32_t rounds = 5;
+
+    DetectorThreadParam _param;
+    const uint32_t slice_len = jin.count("slice_len") ? static_cast<uint32_t >(jin["slice_len"]) : _param.slice_len;
+    const uint32_t trunc_flow_len = jin.count("trunc_flow_len") ? static_cast<uint32_t >(jin["trunc_flow_len"]) : _param.trunc_flow_len;
+
+    vector<PktMetaDataArray > flow_vec;
+    generate_long_flows(flow_vec, flow_num, slice_len, max(slice_len, trunc_flow_len) * 2);
+
+    LOGF("Preprocess Benchmark: %ld Synthetic Flows, Slice Length: %d, Truncation Length: %d, %d Rounds.", 
+            flow_num, slice_len, trunc_flow_len, rounds);
+
+    for (const string _precision : {"float64", "float32"}) {
+
+        json j_target = jin;
+        j_target["precision"] = _precision;
+        j_target["max_batch_size"] = 1;
+
+        DetectorWorkerThread detector({}, {}, j_target);
+        detector.prepare_buffers();
+
+        // 单条序列的输出缓冲, 两条路径都写入其中, 与detect_mts的用法一致
+        torch::Tensor & out = detector.long_batch.input_buf;
+
+        double_t torch_time = 0, native_time = 0, max_abs_dev = 0;
+        uint64_t slice_num = 0;
+
+        for (uint32_t r = 0; r < rounds; r ++) {
+
+            for (const auto & _flat : flow_vec) {
+
+                double_t torch_start_ts = __get_double_ts();
+
+                torch::Tensor slices = detector.preprocess(_flat, false);
+                out.narrow(0, 0, slices.size(0)).copy_(slices);
+
+                double_t torch_end_ts = __get_double_ts();
+
+                // 只在第一轮保存libtorch的结果用于校验
+                torch::Tensor torch_out;
+                if (r == 0) torch_out = out.narrow(0, 0, slices.size(0)).clone();
+
+                double_t native_start_ts = __get_double_ts();
+
+                const int64_t _n = detector.preprocess_native(_flat, false, out, 0);
+
+                double_t native_end_ts = __get_double_ts();
+
+                torch_time += (torch_end_ts - torch_start_ts);
+                native_time += (native_end_ts - native_start_ts);
+                slice_num += _n;
+
+                if (r == 0) {
+                    torch::Tensor _dev = (out.narrow(0, 0, _n).to(torch::kFloat64) - torch_out.to(torch::kFloat64)).abs();
+                    max_abs_dev = max(max_abs_dev, _dev.max().item<double_t >());
+                }
+
+            }
+
+        }
+
+        printf("[Preprocess Benchmark] %7s -> Torch Op Chain: %8.3lf us/flow, Native Kernel: %8.3lf us/flow (%5.2lfx), Slices/Flow: %5.2lf, Max Abs Dev: %.3e\n", 
+                _precision.c_str(), 
+                torch_time / (flow_num * rounds) * 1e6, native_time / (flow_num * rounds) * 1e6, torch_time / native_time,
+                static_cast<double_t >(slice_num) / (flow_num * rounds), max_abs_dev);
+
+    }
+
+}
+
+void Reaper::benchmark_detector_backend(const json & jin) {
+
+    const size_t flow_num = 2000;
+
+    DetectorThreadParam _param;
+    const uint32_t slice_len = jin.count("slice_len") ? static_cast<uint32_t >(jin["slice_len"]) : _param.slice_len;
+    const uint32_t trunc_flow_len = jin.count("trunc_flow_len") ? static_cast<uint32_t >(jin["trunc_flow_len"]) : _param.trunc_flow_len;
+
+    vector<PktMetaDataArray > flow_vec;
+    generate_long_flows(flow_vec, flow_num, slice_len, max(slice_len, trunc_flow_len));
+
+    c10::InferenceMode inference_guard;
+
+    // 两个后端都以float32运行, 原生后端不能使用冻结后的模块, 因此各自从模型表加载
+    ModelRegistry registry;
+    unique_ptr<DetectorWorkerThread > p_detector[2];
+    double_t load_time[2];
+
+    for (size_t i = 0; i < 2; i ++) {
+
+        json j_target = jin;
+        j_target["precision"] = "float32";
+        j_target["backend"] = (i == 0) ? "torchscript" : "native";
+
+        p_detector[i] = make_unique<DetectorWorkerThread >(vector<shared_ptr<InspectorWorkerThread > >(), vector<shared_ptr<AggregatorWorkerThread > >(), j_target);
+
+        double_t load_start_ts = __get_double_ts();
+        p_detector[i]->load_models(registry);
+        load_time[i] = __get_double_ts() - load_start_ts;
+
+        p_detector[i]->prepare_buffers();
+
+    }
+
+    DetectorWorkerThread & torch_detector = *p_detector[0];
+    DetectorWorkerThread & native_detector = *p_detector[1];
+
+    LOGF("Backend Benchmark: %ld Synthetic Flows, Slice Length: %d, Truncation Length: %d, Model: %s, Load Time: [TorchScript %4.4lf s, Native %4.4lf s].", 
+            flow_num, slice_len, trunc_flow_len, torch_detector.p_detector_param->long_model_path.c_str(), load_time[0], load_time[1]);
+
+    // 两种批形态: 逐条序列(无批处理), 以及凑满max_batch_size的批
+    for (const bool batching : {false, true}) {
+
+        const uint32_t batch_th = batching ? torch_detector.p_detector_param->max_batch_size : 1;
+
+        torch::Tensor & input_buf = torch_detector.long_batch.input_buf;
+
+        double_t torch_time = 0, native_time = 0, max_abs_dev = 0, max_abs_out = 0;
+        uint64_t batch_num = 0, slice_num = 0;
+        int64_t offset = 0;
+
+        for (size_t i = 0; i < flow_num; i ++) {
+
+            offset += torch_detector.preprocess_native(flow_vec[i], false, input_buf, offset);
+
+            if (offset < batch_th && i + 1 < flow_num) continue;
+
+            const torch::Tensor input = input_buf.narrow(0, 0, offset);
+
+            double_t torch_start_ts = __get_double_ts();
+            torch::Tensor torch_out = torch_detector.p_long_backend->forward(input);
+            double_t native_start_ts = __get_double_ts();
+            torch::Tensor native_out = native_detector.p_long_backend->forward(input);
+            double_t native_end_ts = __get_double_ts();
+
+            torch_time += (native_start_ts - torch_start_ts);
+            native_time += (native_end_ts - native_start_ts);
+
+            if (!torch_out.defined() || torch_out.sizes() != native_out.sizes()) {
+
+                FATAL_ERROR("Output Shapes of TorchScript and Native Backends Mismatch (Unsupported Model Structure).");
+
+            }
+
+            max_abs_dev = max(max_abs_dev, (torch_out - native_out).abs().max().item<double_t >());
+            max_abs_out = max(max_abs_out, torch_out.abs().max().item<double_t >());
+
+            if (!NativeRNNModel::within_parity(native_out, torch_out)) {
+
+                FATAL_ERROR("Outputs of TorchScript and Native Backends Deviate by " + to_string(max_abs_dev) + 
+                            ", Beyond the Tolerance (atol " + to_string(NativeRNNModel::PARITY_ATOL) + ", rtol " + to_string(NativeRNNModel::PARITY_RTOL) + ").");
+
+            }
+
+            batch_num ++;
+            slice_num += offset;
+            offset = 0;
+
+        }
+
+        printf("[Backend Benchmark] %s -> TorchScript: %8.3lf us/batch (%9.1lf slices/s), Native: %8.3lf us/batch (%9.1lf slices/s), %5.2lfx, Slices/Batch: %6.1lf, Max Abs Dev: %.3e (Max |Output|: %.3e)\n", 
+                batching ? "Batched " : "Per-Flow",
+                torch_time / batch_num * 1e6, slice_num / torch_time, 
+                native_time / batch_num * 1e6, slice_num / native_time, torch_time / native_time,
+                static_cast<double_t >(slice_num) / batch_num, max_abs_dev, max_abs_out);
+
+    }
+
+}
+
+void Reaper::benchmark_detector_streaming(const json & jin) {
+
+    const size_t flow_num = 2000;
+
+    DetectorThreadParam _param;
+    const uint32_t slice_len = jin.count("slice_len") ? static_cast<uint32_t >(jin["slice_len"]) : _param.slice_len;
+    const uint32_t trunc_flow_len = jin.count("trunc_flow_len") ? static_cast<uint32_t >(jin["trunc_flow_len"]) : _param.trunc_flow_len;
+
+    vector<PktMetaDataArray > flow_vec;
+    generate_long_flows(flow_vec, flow_num, slice_len, max(slice_len, trunc_flow_len));
+
+    c10::InferenceMode inference_guard;
+
+    json j_target = jin;
+    j_target["precision"] = "float32";
+    j_target["backend"] = "native";
+    j_target["streaming_inference"] = true;
+
+    ModelRegistry registry;
+    DetectorWorkerThread detector({}, {}, j_target);
+    detector.load_models(registry);
+    detector.prepare_buffers();
+
+    const uint32_t stride = detector.p_detector_param->stride;
+    const uint32_t batch_th = detector.p_detector_param->max_batch_size;
+
+    LOGF("Streaming Benchmark: %ld Synthetic Flows, Slice Length: %d, Stride: %d, Truncation Length: %d, Model: %s.", 
+            flow_num, slice_len, stride, trunc_flow_len, detector.p_detector_param->long_model_path.c_str());
+
+    // 1. 逐slice推断与流式推断: 同一批序列, 窗口一一对应
+    torch::Tensor & slice_buf = detector.long_batch.input_buf;
+    torch::Tensor row_buf = detector.aggr_batch.input_buf.view({-1, 3});
+
+    double_t windowed_time = 0, streaming_time = 0, max_abs_dev = 0, sum_abs_dev = 0, max_abs_out = 0;
+    uint64_t batch_num = 0, window_num = 0, pkt_num = 0;
+    int64_t slice_offset = 0, row_offset = 0;
+    vector<int64_t > row_num_vec;
+
+    for (size_t i = 0; i < flow_num; i ++) {
+
+        slice_offset += detector.preprocess_native(flow_vec[i], false, slice_buf, slice_offset);
+        row_num_vec.push_back(detector.preprocess_rows(flow_vec[i], false, row_buf, row_offset));
+        row_offset += row_num_vec.back();
+
+        if (slice_offset < batch_th && i + 1 < flow_num) continue;
+
+        double_t windowed_start_ts = __get_double_ts();
+        torch::Tensor windowed_out = detector.p_long_backend->forward(slice_buf.narrow(0, 0, slice_offset));
+        double_t streaming_start_ts = __get_double_ts();
+        torch::Tensor streaming_out = detector.p_long_backend->forward_stream(row_buf.narrow(0, 0, row_offset), row_num_vec, slice_len, stride, {});
+        double_t streaming_end_ts = __get_double_ts();
+
+        windowed_time += (streaming_start_ts - windowed_start_ts);
+        streaming_time += (streaming_end_ts - streaming_start_ts);
+
+        if (windowed_out.sizes() != streaming_out.sizes()) {
+
+            FATAL_ERROR("Window Numbers of Windowed and Streaming Inference Mismatch.");
+
+        }
+
+        const torch::Tensor _dev = (windowed_out - streaming_out).abs();
+        max_abs_dev = max(max_abs_dev, _dev.max().item<double_t >());
+        sum_abs_dev += _dev.sum().item<double_t >();
+        max_abs_out = max(max_abs_out, windowed_out.abs().max().item<double_t >());
+
+        batch_num ++;
+        window_num += slice_offset;
+        pkt_num += row_offset;
+        slice_offset = row_offset = 0;
+        row_num_vec.clear();
+
+    }
+
+    const size_t output_dim = registry.acquire_native(detector.p_detector_param->long_model_path)->output_dim();
+
+    printf("[Streaming Benchmark] Windowed: %8.3lf us/batch (%9.1lf pkts/s), Streaming: %8.3lf us/batch (%9.1lf pkts/s), %5.2lfx, Windows/Batch: %6.1lf\n", 
+            windowed_time / batch_num * 1e6, pkt_num / windowed_time, 
+            streaming_time / batch_num * 1e6, pkt_num / streaming_time, windowed_time / streaming_time,
+            static_cast<double_t >(window_num) / batch_num);
+
+    // 流式窗口的输出带有窗口之前的历史, 与逐slice推断只在第一个窗口上完全一致
+    printf("[Streaming Benchmark] Streaming vs Windowed -> Max Abs Dev: %.3e, Mean Abs Dev: %.3e (Max |Output|: %.3e)\n", 
+            max_abs_dev, sum_abs_dev / (window_num * output_dim), max_abs_out);
+
+    // 2. 增量评分: 每条流的数据包按随机大小分段到达, 与detector相同, 经后端从每条流的状态续接, 结果应与整条序列一次流式推断一致
+    NativeRNNModel::StreamState state;
+    mt19937 rng(flow_num);
+
+    double_t incremental_time = 0, max_chunk_dev = 0;
+    uint64_t chunk_num = 0;
+    pkt_num = 0;
+
+    for (size_t i = 0; i < flow_num; i ++) {
+
+        const int64_t _rows = detector.preprocess_rows(flow_vec[i], false, row_buf, 0);
+        const torch::Tensor full_out = detector.p_long_backend->forward_stream(row_buf.narrow(0, 0, _rows), {_rows}, slice_len, stride, {}).contiguous();
+
+        torch::Tensor chunk_out = torch::empty_like(full_out);
+        int64_t out_offset = 0;
+
+        state = NativeRNNModel::StreamState();
+
+        for (int64_t _pos = 0; _pos < _rows; ) {
+
+            const int64_t _len = min<int64_t >(1 + rng() % (2 * stride), _rows - _pos);
+
+            double_t chunk_start_ts = __get_double_ts();
+            const torch::Tensor _out = detector.p_long_backend->forward_stream(row_buf.narrow(0, _pos, _len), {_len}, slice_len, stride, {&state});
+            incremental_time += (__get_double_ts() - chunk_start_ts);
+
+            if (_out.size(0)) chunk_out.narrow(0, out_offset, _out.size(0)).copy_(_out);
+            out_offset += _out.size(0);
+
+            _pos += _len;
+            chunk_num ++;
+
+        }
+
+        if (out_offset != full_out.size(0)) {
+
+            FATAL_ERROR("Window Numbers of Incremental and One-Shot Streaming Inference Mismatch.");
+
+        }
+
+        if (out_offset > 0) max_chunk_dev = max(max_chunk_dev, (chunk_out - full_out).abs().max().item<double_t >());
+        pkt_num += _rows;
+
+    }
+
+    printf("[Streaming Benchmark] Incremental: %8.3lf us/chunk, %6.3lf us/pkt, %5.2lf Pkts/Chunk, Max Abs Dev vs One-Shot: %.3e\n", 
+            incremental_time / chunk_num * 1e6, incremental_time / pkt_num * 1e6, static_cast<double_t >(pkt_num) / chunk_num, max_chunk_dev);
+
+}
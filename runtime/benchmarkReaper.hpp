@@ -0,0 +1,27 @@
+#pragma once
+
+#include "dpdkAppUtility.hpp"
+
+namespace Reaper
+{
+
+// 离线基准测试, 不依赖DPDK运行时环境, 由main.cpp中的命令行标志触发
+
+// IPTrie插入与aggregate()的吞吐, 每个aggr_cycle分别为10k/100k/1M条短流
+// 使用Aggregator参数中的shortest_prefix_len, aggr_len_th与trunc_flow_len
+void benchmark_ip_trie(const json & j_aggregator_params);
+
+// 以float64为基线, 报告float32与int8(存在<model>_int8.pt时)推断输出的偏差与耗时
+// 使用Detector参数, 输入为合成的长流
+void validate_detector_precision(const json & j_detector_params);
+
+// 融合的native预处理kernel与libtorch算子链的耗时对比, 并校验两者输出一致(float64/float32)
+void benchmark_detector_preprocess(const json & j_detector_params);
+
+// 原生RNN后端与libtorch后端的一致性检查(逐元素最大偏差)及逐条/批量推断的吞吐与延迟对比
+void benchmark_detector_backend(const json & j_detector_params);
+
+// 有状态的流式推断与逐slice推断(原生后端)的耗时与窗口输出偏差, 以及分段到达时增量评分与一次推断的一致性
+void benchmark_detector_streaming(const json & j_detector_params);
+
+}
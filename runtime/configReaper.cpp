@@ -297,13 +297,21 @@ bool ConfigReaper::create_worker_threads(const dpdk_dev_map_list_t dpdk_dev_map_
 
 		}
 
-		const shared_ptr<InspectorWorkerThread > p_inspector_thread_i = make_shared<InspectorWorkerThread >(assembler_vec);
+		const shared_ptr<InspectorWorkerThread > p_inspector_thread_i = make_shared<InspectorWorkerThread >(assembler_vec, assembler_thread_vec);
 
 		if (p_inspector_thread_i == nullptr) {
 		
 			FATAL_ERROR("Bad Memory Allocation for Inspector Thread.");
 
 		}
+
+		// assembler提前发送的长流与本地inspector过期发送的长流共用同一个long_queue与分类表
+		for (const auto & p_assembler : assembler_vec) {
+
+			p_assembler->p_long_queue = p_inspector_thread_i->p_long_queue;
+			p_assembler->p_flow_classifier = p_inspector_thread_i->p_flow_classifier;
+
+		}
 		
 		if (j_inspector_params.size() != 0) {
 
@@ -311,11 +319,27 @@ bool ConfigReaper::create_worker_threads(const dpdk_dev_map_list_t dpdk_dev_map_
 
 		}
 
+		// assembler在持有流表bucket写锁时提前发送长流, 不能在long_queue上阻塞等待
+		if (p_inspector_thread_i->p_inspector_param->long_queue_param.policy == OverloadPolicy::BLOCK) {
+
+			for (const auto & p_assembler : assembler_vec) {
+
+				if (p_assembler->p_assembler_param->early_emission) {
+
+					FATAL_ERROR("Policy(block) of Inspector long_queue Cannot be Used with Early Emission of Assembler.");
+
+				}
+
+			}
+
+		}
+
 		inspector_thread_vec.push_back(p_inspector_thread_i);
 
 		if (display_once) {
 
 			p_inspector_thread_i->p_inspector_param->display_params();
+			p_inspector_thread_i->p_flow_classifier->display_params();
 
 			display_once = false;
 
@@ -327,7 +351,7 @@ bool ConfigReaper::create_worker_threads(const dpdk_dev_map_list_t dpdk_dev_map_
 
 	for (cpu_core_id_t i = 0; i < p_dpdk_runtime_env_param->aggregator_cores_num; i ++) {
 
-		const shared_ptr<AggregatorWorkerThread > p_aggregator_thread_i = make_shared<AggregatorWorkerThread >(inspector_thread_vec);
+		const shared_ptr<AggregatorWorkerThread > p_aggregator_thread_i = make_shared<AggregatorWorkerThread >();
 
 		if (p_aggregator_thread_i == nullptr) {
 
@@ -349,6 +373,25 @@ bool ConfigReaper::create_worker_threads(const dpdk_dev_map_list_t dpdk_dev_map_
 
 	}
 
+	// 短流按bound prefix划分至aggregators, 每个前缀只属于一棵IPTrie
+	if (!aggregator_thread_vec.empty()) {
+
+		vector<shared_ptr<ShortFlowQueue > > short_flow_queue_vec;
+
+		for (const auto & p_aggregator : aggregator_thread_vec) short_flow_queue_vec.push_back(p_aggregator->p_short_flow_queue);
+
+		const uint32_t bound_prefix_length = aggregator_thread_vec[0]->p_aggregator_param->shortest_prefix_len;
+		const uint32_t bound_prefix_mask = bound_prefix_length == 0 ? 0 : ~uint32_t(0) << (32 - bound_prefix_length);
+
+		for (const auto & p_inspector : inspector_thread_vec) {
+
+			p_inspector->p_short_flow_queue_vec = short_flow_queue_vec;
+			p_inspector->aggr_bound_prefix_mask = bound_prefix_mask;
+
+		}
+
+	}
+
 	display_once = true;
 
 	for (cpu_core_id_t i = 0; i < p_dpdk_runtime_env_param->detector_cores_num; i ++) {
@@ -375,6 +418,110 @@ bool ConfigReaper::create_worker_threads(const dpdk_dev_map_list_t dpdk_dev_map_
 
 	}
 
+	// 每个类别一个共享的工作队列: 所有inspectors/assemblers写入long队列, 所有aggregators写入aggr队列, 所有detectors整批取出
+	// 队列参数沿用各生产者的long_queue/short_aggr_queue配置, BLOCK策略下每个生产者以自身的终止标记作为放弃等待的条件
+	if (!detector_thread_vec.empty()) {
+
+		shared_ptr<PktMetaDataArrayOutputQueue > p_long_work_queue = make_shared<PktMetaDataArrayOutputQueue >();
+		shared_ptr<PktMetaDataArrayOutputQueue > p_aggr_work_queue = make_shared<PktMetaDataArrayOutputQueue >();
+
+		if (!inspector_thread_vec.empty()) p_long_work_queue->configure(inspector_thread_vec[0]->p_inspector_param->long_queue_param, nullptr);
+		if (!aggregator_thread_vec.empty()) p_aggr_work_queue->configure(aggregator_thread_vec[0]->p_aggregator_param->short_aggr_queue_param, nullptr);
+
+		for (const auto & p_inspector : inspector_thread_vec) p_inspector->p_long_queue = p_long_work_queue;
+		for (const auto & p_assembler : assembler_thread_vec) p_assembler->p_long_queue = p_long_work_queue;
+		for (const auto & p_aggregator : aggregator_thread_vec) p_aggregator->p_short_aggr_queue = p_aggr_work_queue;
+
+		for (const auto & p_detector : detector_thread_vec) {
+
+			p_detector->p_work_queue[static_cast<uint8_t >(DetectorModel::LONG_MODEL)] = p_long_work_queue;
+			p_detector->p_work_queue[static_cast<uint8_t >(DetectorModel::AGGR_MODEL)] = p_aggr_work_queue;
+
+		}
+
+		// 增量评分: 每个detector一个私有的流式分段队列, assemblers与inspectors按流划分写入, 同一条流的各段只由一个detector续接其状态
+		if (!assembler_thread_vec.empty() && assembler_thread_vec[0]->p_assembler_param->stream_chunk_len) {
+
+			const shared_ptr<DetectorThreadParam > & p_param = detector_thread_vec[0]->p_detector_param;
+
+			if (!p_param->streaming_inference) {
+
+				FATAL_ERROR("Parameter(stream_chunk_len) of Assembler Requires Streaming Inference of Detector.");
+
+			}
+
+			// assembler在持有流表bucket写锁时写入分段, 不能阻塞等待
+			if (p_param->stream_queue_param.policy == OverloadPolicy::BLOCK) {
+
+				FATAL_ERROR("Policy(block) of Detector stream_queue Cannot be Used with Streaming Chunks of Assembler.");
+
+			}
+
+			vector<shared_ptr<PktMetaDataArrayOutputQueue > > stream_queue_vec;
+
+			for (const auto & p_detector : detector_thread_vec) {
+
+				p_detector->p_work_queue[DetectorWorkerThread::STREAM_SOURCE] = make_shared<PktMetaDataArrayOutputQueue >(p_param->stream_queue_param);
+				stream_queue_vec.push_back(p_detector->p_work_queue[DetectorWorkerThread::STREAM_SOURCE]);
+
+			}
+
+			for (const auto & p_inspector : inspector_thread_vec) p_inspector->p_stream_queue_vec = stream_queue_vec;
+			for (const auto & p_assembler : assembler_thread_vec) p_assembler->p_stream_queue_vec = stream_queue_vec;
+
+		}
+
+	}
+
+	// 所有detector从同一模型表获取模型, 启动时间与内存随模型数而非detector数增长; 每个模型在此预热一次, 之后才启动任何工作线程
+	if (!detector_thread_vec.empty()) {
+
+		const shared_ptr<DetectorThreadParam > & p_param = detector_thread_vec[0]->p_detector_param;
+
+		// inter-op线程池是进程级的, 在任何inter-op任务开始之后无法再设置, 因此须在加载(冻结, 优化与预热)模型之前设置
+		try {
+			torch::set_num_interop_threads(p_param->inter_op_threads);
+		} catch (exception & e) {
+			FATAL_ERROR(string("Fail to Set Inter-Op Threads of LibTorch: ") + e.what());
+		}
+
+		// 预热在主线程上进行, 使用与detector相同的intra-op线程数
+		torch::set_num_threads(p_param->intra_op_threads);
+
+		LOGF("Load Detector Models...");
+
+		p_model_registry = make_shared<ModelRegistry >();
+
+		const double_t load_start_ts = get_time_spec();
+
+		for (const auto & p_detector_thread : detector_thread_vec) p_detector_thread->load_models(*p_model_registry);
+
+		LOGF("%ld Models are Loaded for %ld Detectors in %4.4lf s.", p_model_registry->size(), detector_thread_vec.size(), get_time_spec() - load_start_ts);
+
+	}
+
+	// 检测结论: 每个detector一个无锁ring, 由一个独立的sink线程写出, detector不做任何I/O
+	if (!detector_thread_vec.empty() && detector_thread_vec[0]->p_detector_param->verdict_sink_param.type != VerdictSinkType::NONE) {
+
+		// 每条序列的得分取自批输出中属于它的slices, 对整个输入做规约的模型无法给出逐条序列的结论
+		for (const auto & p_detector : detector_thread_vec) {
+
+			if (!p_detector->long_batch.split_output || !p_detector->aggr_batch.split_output) {
+
+				FATAL_ERROR("Verdict Sink Requires Models whose Output can be Split per Slice.");
+
+			}
+
+		}
+
+		p_verdict_sink = make_shared<VerdictSink >(detector_thread_vec[0]->p_detector_param->verdict_sink_param);
+
+		for (const auto & p_detector : detector_thread_vec) p_detector->p_verdict_ring = p_verdict_sink->add_producer();
+
+		p_verdict_sink->start();
+
+	}
+
 	// // aggreagator num > inspector num
 	// size_t per_inspector_aggregator_num = p_dpdk_runtime_env_param->aggregator_cores_num / inspector_thread_vec.size();
 	// size_t remainder_aggregator_num = p_dpdk_runtime_env_param->aggregator_cores_num % inspector_thread_vec.size(); 
@@ -568,6 +715,67 @@ bool ConfigReaper::create_worker_threads(const dpdk_dev_map_list_t dpdk_dev_map_
 
 }
 
+void ConfigReaper::check_disjoint_cores(const vector<cpu_core_id_t > & cores0, const string & owner0, const vector<cpu_core_id_t > & cores1, const string & owner1) const {
+
+	for (const auto & _core : cores0) {
+
+		if (find(cores1.cbegin(), cores1.cend(), _core) != cores1.cend()) {
+
+			string error_info = owner0 + " Core #" + to_string(_core) + " Overlaps " + owner1 + " Cores.";
+			FATAL_ERROR(error_info);
+
+		}
+
+	}
+
+}
+
+vector<vector<cpu_core_id_t > > ConfigReaper::partition_cores(const vector<cpu_core_id_t > & cores, const size_t instance_num, const string & owner) const {
+
+	if (cores.size() < instance_num) {
+
+		if (!cores.empty()) WARNF("%ld %s Cores for %ld Instances, Cores are Shared.", cores.size(), owner.c_str(), instance_num);
+
+		return vector<vector<cpu_core_id_t > >(instance_num, cores);
+
+	}
+
+	// 第i个实例独占[i * n / k, (i + 1) * n / k)
+	vector<vector<cpu_core_id_t > > core_sets(instance_num);
+
+	for (size_t i = 0; i < instance_num; i ++) {
+
+		core_sets[i].assign(cores.cbegin() + i * cores.size() / instance_num, cores.cbegin() + (i + 1) * cores.size() / instance_num);
+
+	}
+
+	return core_sets;
+
+}
+
+void ConfigReaper::check_arena_cores(const vector<cpu_core_id_t > & arena_cores, const size_t all_machine_cores_num, const string & owner) const {
+
+	// DPDK lcores占用[0, dpdk_cores_num)上的核心
+	for (const auto & _core : arena_cores) {
+
+		if (_core < p_dpdk_runtime_env_param->dpdk_cores_num) {
+
+			string error_info = owner + " Core #" + to_string(_core) + " Overlaps DPDK Worker Cores.";
+			FATAL_ERROR(error_info);
+
+		}
+
+		if (_core >= all_machine_cores_num) {
+
+			string error_info = owner + " Core #" + to_string(_core) + " Exceeds Maximum Number of Cores in Current Machine.";
+			FATAL_ERROR(error_info);
+
+		}
+
+	}
+
+}
+
 void ConfigReaper::interrupt_callback(void* cookie) {
 
 	ThreadStateMonitor* monitor = (ThreadStateMonitor*) cookie;
@@ -644,17 +852,8 @@ void ConfigReaper::interrupt_callback(void* cookie) {
 	double_t pre_pkt_len = 0;
 	double_t inference_pkt_len = 0;
 
-	ofstream f; 
-	f.open("../" + monitor->detector_worker_thread_vec[0]->p_detector_param->model + "latency.txt", ios::out);
-
 	for (size_t i = 0; i < monitor->detector_worker_thread_vec.size(); i ++) {
 
-		for (const auto & _t : monitor->detector_worker_thread_vec[i]->inference_latency) {
-
-			f << _t << endl;
-
-		}
-
 		const pair<double_t, double_t > performance_i = monitor->detector_worker_thread_vec[i]->get_overall_performance();
 
 		pre_pkt_len += performance_i.first;
@@ -667,10 +866,91 @@ void ConfigReaper::interrupt_callback(void* cookie) {
 		LOGF("Detector (PreProcessing) Overall Performance: [%4.4lf Gbps]", pre_pkt_len);
 		LOGF("Detector (Infernece) Overall Performance: [%4.4lf Gbps]", inference_pkt_len);
 
+		if (monitor->p_model_registry) monitor->p_model_registry->display_profiles();
+
+		for (size_t i = 0; i < monitor->detector_worker_thread_vec.size(); i ++) {
+
+			const shared_ptr<DetectorWorkerThread > & p_detector = monitor->detector_worker_thread_vec[i];
+
+			const pair<double_t, double_t > cascade = p_detector->get_cascade_performance();
+
+			LOGF("Detector #%ld Cascade: [Pre-Filter %s, Escalation Rate %4.2lf%%, Effective %4.4lf Gbps]", 
+					i, p_detector->p_detector_param->prefilter ? "On" : "Off", cascade.first * 100, cascade.second);
+
+			const pair<double_t, double_t > long_queueing = p_detector->get_queueing_performance(DetectorModel::LONG_MODEL);
+			const pair<double_t, double_t > aggr_queueing = p_detector->get_queueing_performance(DetectorModel::AGGR_MODEL);
+
+			LOGF("Detector #%ld Queueing Delay: [Long %4.4lf ms (%4.2lf%% Missed), Aggr %4.4lf ms (%4.2lf%% Missed)]", 
+					i, long_queueing.first * 1e3, long_queueing.second * 100, aggr_queueing.first * 1e3, aggr_queueing.second * 100);
+
+			if (p_detector->unsplit_batch_num) WARNF("Detector #%ld Wrote No Verdicts for %ld Batches whose Output Cannot be Split per Slice.", i, p_detector->unsplit_batch_num);
+
+			for (size_t k = 0; k < LATENCY_STAGE_NUM; k ++) {
+
+				const LatencyStage _stage = static_cast<LatencyStage >(k);
+
+				LOGF("Detector #%ld %s Latency: [%s]", i, latency_stage_name(_stage), p_detector->get_latency_histogram(_stage).to_string().c_str());
+
+			}
+
+		}
+
+		// 各detector的直方图同构, 按桶合并得到整体的延迟分布
+		for (size_t k = 0; k < LATENCY_STAGE_NUM; k ++) {
+
+			const LatencyStage _stage = static_cast<LatencyStage >(k);
+
+			LatencyHistogram overall_hist;
+
+			for (const auto & p_detector : monitor->detector_worker_thread_vec) overall_hist.merge(p_detector->get_latency_histogram(_stage));
+
+			LOGF("Detector Overall %s Latency: [%s]", latency_stage_name(_stage), overall_hist.to_string().c_str());
+
+		}
+
+	}
+
+	// detectors已停止, 写完ring中剩余的结论
+	if (monitor->p_verdict_sink) {
+
+		monitor->p_verdict_sink->stop();
+		monitor->p_verdict_sink->display_stats();
+
 	}
 	
 	// #endif
 
+	LOGF("Inter-Stage Queue Statistics:");
+
+	for (size_t i = 0; i < monitor->assembler_worker_thread_vec.size(); i ++) {
+
+		monitor->assembler_worker_thread_vec[i]->last_pool_queue.display_stats(("last_pool_queue#" + to_string(i)).c_str());
+
+	}
+
+	for (size_t i = 0; i < monitor->aggregator_worker_thread_vec.size(); i ++) {
+
+		monitor->aggregator_worker_thread_vec[i]->p_short_flow_queue->display_stats(("short_flow_queue#" + to_string(i)).c_str());
+		monitor->aggregator_worker_thread_vec[i]->ip_trie_queue.display_stats(("ip_trie_queue#" + to_string(i)).c_str());
+
+	}
+
+	// long_queue与short_aggr_queue已被替换为所有生产者共享的工作队列
+	if (!monitor->detector_worker_thread_vec.empty()) {
+
+		monitor->detector_worker_thread_vec[0]->p_work_queue[static_cast<uint8_t >(DetectorModel::LONG_MODEL)]->display_stats("long_work_queue");
+		monitor->detector_worker_thread_vec[0]->p_work_queue[static_cast<uint8_t >(DetectorModel::AGGR_MODEL)]->display_stats("aggr_work_queue");
+
+		for (size_t i = 0; i < monitor->detector_worker_thread_vec.size(); i ++) {
+
+			const auto & p_stream_queue = monitor->detector_worker_thread_vec[i]->p_work_queue[DetectorWorkerThread::STREAM_SOURCE];
+
+			if (p_stream_queue) p_stream_queue->display_stats(("stream_queue#" + to_string(i)).c_str());
+
+		}
+
+	}
+
 	monitor->stop = true;
 
 }
@@ -792,6 +1072,10 @@ bool ConfigReaper::load_params_via_json(const json & jin) {
 		} else {
 			FATAL_ERROR("Parameter(parser_cores_num) is Missing!");
 		}
+		// TBB global concurrency
+		if (dpdk_params.count("tbb_max_concurrency")) {
+			p_dpdk_runtime_env_param->tbb_max_concurrency = static_cast<size_t>(dpdk_params["tbb_max_concurrency"]);
+		}
 
 		return true;
 
@@ -915,6 +1199,122 @@ void ConfigReaper::enable_reaper() {
 
 	}
 
+	LOGF("Configure TBB Arenas...");
+
+	if (!inspector_thread_vec.empty()) {
+
+		const vector<cpu_core_id_t > & arena_cores = inspector_thread_vec[0]->p_inspector_param->arena_cores;
+
+		check_arena_cores(arena_cores, all_machine_cores_num, "Inspector Arena");
+
+		// 每个inspector的arena独占arena_cores中的一段, 避免多个arena的worker线程挤在同一组核心上
+		const vector<vector<cpu_core_id_t > > core_sets = partition_cores(arena_cores, inspector_thread_vec.size(), "Inspector Arena");
+
+		for (size_t i = 0; i < inspector_thread_vec.size(); i ++) inspector_thread_vec[i]->arena_core_set = core_sets[i];
+
+	}
+
+	if (!aggregator_thread_vec.empty()) {
+
+		const vector<cpu_core_id_t > & arena_cores = aggregator_thread_vec[0]->p_aggregator_param->arena_cores;
+
+		check_arena_cores(arena_cores, all_machine_cores_num, "Aggregator Arena");
+
+		// 两类arena的worker线程不得落在同一组核心上
+		if (!inspector_thread_vec.empty()) check_disjoint_cores(arena_cores, "Aggregator Arena", inspector_thread_vec[0]->p_inspector_param->arena_cores, "Inspector Arena");
+
+		// 与inspectors相同, 每个aggregator的arena独占arena_cores中的一段
+		const vector<vector<cpu_core_id_t > > core_sets = partition_cores(arena_cores, aggregator_thread_vec.size(), "Aggregator Arena");
+
+		for (size_t i = 0; i < aggregator_thread_vec.size(); i ++) aggregator_thread_vec[i]->arena_core_set = core_sets[i];
+
+		const vector<cpu_core_id_t > & exec_cores = aggregator_thread_vec[0]->p_aggregator_param->exec_cores;
+
+		if (!exec_cores.empty()) {
+
+			if (exec_cores.size() < aggregator_thread_vec.size()) {
+
+				FATAL_ERROR("Parameter(exec_cores) of Aggregator Must Provide One Core for Each Aggregator.");
+
+			}
+
+			check_arena_cores(exec_cores, all_machine_cores_num, "Aggregator Exec");
+
+			// 每个聚合线程独占一个核心, 不与其他聚合线程或任何arena的worker线程共享
+			for (auto it = exec_cores.cbegin(); it != exec_cores.cend(); it ++) {
+
+				if (find(exec_cores.cbegin(), it, *it) != it) {
+
+					string error_info = "Aggregator Exec Core #" + to_string(*it) + " is Assigned More Than Once.";
+					FATAL_ERROR(error_info);
+
+				}
+
+			}
+
+			check_disjoint_cores(exec_cores, "Aggregator Exec", arena_cores, "Aggregator Arena");
+			if (!inspector_thread_vec.empty()) check_disjoint_cores(exec_cores, "Aggregator Exec", inspector_thread_vec[0]->p_inspector_param->arena_cores, "Inspector Arena");
+
+			for (size_t i = 0; i < aggregator_thread_vec.size(); i ++) aggregator_thread_vec[i]->exec_core = exec_cores[i];
+
+		}
+
+	}
+
+	LOGF("Configure LibTorch Threads...");
+
+	if (!detector_thread_vec.empty()) {
+
+		const shared_ptr<DetectorThreadParam > & p_param = detector_thread_vec[0]->p_detector_param;
+
+		check_arena_cores(p_param->torch_cores, all_machine_cores_num, "Detector Torch");
+
+		// intra-op线程不得落在TBB arena的worker或绑定的聚合线程所在的核心上
+		if (!inspector_thread_vec.empty()) {
+			check_disjoint_cores(p_param->torch_cores, "Detector Torch", inspector_thread_vec[0]->p_inspector_param->arena_cores, "Inspector Arena");
+		}
+
+		if (!aggregator_thread_vec.empty()) {
+			check_disjoint_cores(p_param->torch_cores, "Detector Torch", aggregator_thread_vec[0]->p_aggregator_param->arena_cores, "Aggregator Arena");
+			check_disjoint_cores(p_param->torch_cores, "Detector Torch", aggregator_thread_vec[0]->p_aggregator_param->exec_cores, "Aggregator Exec");
+		}
+
+		// 每个detector额外需要(intra_op_threads - 1)个线程; 核心足够时各detector独占一段, 否则共享全部torch_cores
+		const size_t extra_thread_num = p_param->intra_op_threads - 1;
+
+		if (extra_thread_num > 0 && p_param->torch_cores.empty()) {
+
+			WARN("Parameter(torch_cores) of Detector is Empty, Intra-Op Threads Share the Detector Cores.");
+
+		} else if (extra_thread_num > 0) {
+
+			const bool exclusive = p_param->torch_cores.size() >= extra_thread_num * detector_thread_vec.size();
+
+			if (!exclusive) WARNF("%ld Torch Cores for %ld Detectors x %ld Extra Intra-Op Threads, Cores are Shared.", 
+									p_param->torch_cores.size(), detector_thread_vec.size(), extra_thread_num);
+
+			for (size_t i = 0; i < detector_thread_vec.size(); i ++) {
+
+				if (exclusive) {
+					detector_thread_vec[i]->torch_core_set.assign(p_param->torch_cores.cbegin() + i * extra_thread_num, 
+																	p_param->torch_cores.cbegin() + (i + 1) * extra_thread_num);
+				} else {
+					detector_thread_vec[i]->torch_core_set = p_param->torch_cores;
+				}
+
+			}
+
+		}
+
+	}
+
+	if (p_dpdk_runtime_env_param->tbb_max_concurrency) {
+
+		p_tbb_global_control = make_unique<tbb::global_control >(tbb::global_control::max_allowed_parallelism, 
+																	p_dpdk_runtime_env_param->tbb_max_concurrency);
+
+	}
+
 	LOGF("Start DPDK Worker Threads...");
 
 	#ifdef SPLIT_START
@@ -1031,6 +1431,8 @@ void ConfigReaper::enable_reaper() {
 
 	// Monitor of worker threads, response to Interrupt
 	ThreadStateMonitor monitor(parser_thread_vec, assembler_thread_vec, inspector_thread_vec, aggregator_thread_vec, detector_thread_vec);
+	monitor.p_verdict_sink = p_verdict_sink;
+	monitor.p_model_registry = p_model_registry;
 	
 	ApplicationEventHandler::getInstance().onApplicationInterrupted(interrupt_callback, &monitor);
 
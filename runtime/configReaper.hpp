@@ -18,6 +18,8 @@ class AssemblerWorkerThread;
 class AggregatorWorkerThread;
 class InspectorWorkerThread;
 class DetectorWorkerThread;
+class ModelRegistry;
+class VerdictSink;
 
 // the Configuration Parameters for Reaper runtime env
 struct DpdkRuntimeEnvParam final {
@@ -40,6 +42,9 @@ struct DpdkRuntimeEnvParam final {
     cpu_core_id_t detector_cores_num = 0;
     cpu_core_id_t dpdk_cores_num = 0;
 
+    // TBB全局并发上限 (global_control), 0表示不设上限
+    size_t tbb_max_concurrency = 0;
+
     void inline display_params() const {
         
         printf("[ ***DpdkRuntimeEnvParam*** ]\n");
@@ -55,6 +60,9 @@ struct DpdkRuntimeEnvParam final {
         printf("[Memory] -> Memory Pool Size: %d\n", mem_pool_size);
 
         printf("[CPU] -> Occupied Core Num: %d (%d for parser, %d for assembler)\n", dpdk_cores_num, parser_cores_num, assembler_cores_num);
+
+        if (tbb_max_concurrency) printf("[TBB] -> Max Allowed Concurrency: %ld\n", tbb_max_concurrency);
+        else printf("[TBB] -> Max Allowed Concurrency: Unlimited\n");
     }
 
     DpdkRuntimeEnvParam() {}
@@ -75,6 +83,12 @@ struct ThreadStateMonitor final {
     vector<shared_ptr<AggregatorWorkerThread > > aggregator_worker_thread_vec;
     vector<shared_ptr<DetectorWorkerThread> > detector_worker_thread_vec;
 
+    // stopped and reported after all detectors have stopped
+    shared_ptr<VerdictSink > p_verdict_sink;
+
+    // warm-up latencies of the shared models
+    shared_ptr<ModelRegistry > p_model_registry;
+
 	ThreadStateMonitor() = default;
     virtual ~ThreadStateMonitor() {}
     ThreadStateMonitor & operator=(const ThreadStateMonitor &) = default;
@@ -124,6 +138,24 @@ private:
                                     vector<shared_ptr<AggregatorWorkerThread > > & aggregator_thread_vec,
                                     vector<shared_ptr<DetectorWorkerThread > > & detector_thread_vec);
 
+    // check that cores reserved for TBB arenas exist and do not overlap the DPDK lcores
+    void check_arena_cores(const vector<cpu_core_id_t > & arena_cores, const size_t all_machine_cores_num, const string & owner) const;
+
+    // check that two reserved core sets share no core
+    void check_disjoint_cores(const vector<cpu_core_id_t > & cores0, const string & owner0, const vector<cpu_core_id_t > & cores1, const string & owner1) const;
+
+    // split cores into instance_num contiguous slices, one per instance (all instances share the cores if there are too few)
+    vector<vector<cpu_core_id_t > > partition_cores(const vector<cpu_core_id_t > & cores, const size_t instance_num, const string & owner) const;
+
+    // TorchScript models shared by all detectors, each loaded only once
+    shared_ptr<ModelRegistry > p_model_registry;
+
+    // single sink thread writing the verdicts of all detectors (null if the sink is disabled)
+    shared_ptr<VerdictSink > p_verdict_sink;
+
+    // cap on the total number of TBB threads of the process
+    unique_ptr<tbb::global_control > p_tbb_global_control;
+
     // take actions when dpdk app is interrupted
     static void interrupt_callback(void* cookie);
 
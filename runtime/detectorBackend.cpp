@@ -0,0 +1,696 @@
+#include "detectorBackend.hpp"
+
+// x86上AVX2/FMA的kernel以函数级的target属性单独编译, 启动时检测CPU后选用, 不支持时使用标量实现;
+// 整个文件不使用-mavx2, 避免头文件中的inline函数以AVX2编译后被链接到整个程序
+#if defined(__x86_64__) || defined(__i386__)
+#define NATIVE_AVX2_KERNELS
+#define NATIVE_AVX2_TARGET __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#endif
+
+using namespace Reaper;
+
+static inline float __sigmoid(const float x) {
+
+    return 1.0f / (1.0f + expf(-x));
+
+}
+
+#ifdef NATIVE_AVX2_KERNELS
+
+static bool __cpu_supports_avx2_fma() {
+
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+}
+
+static const bool __use_avx2 = __cpu_supports_avx2_fma();
+
+// 8路expf: 2^n * p(r), r = x - n * ln2, p为Cephes的6阶多项式, 相对误差约1e-7
+static inline NATIVE_AVX2_TARGET __m256 __exp_ps(__m256 x) {
+
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+
+    const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    const __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+
+}
+
+static inline NATIVE_AVX2_TARGET __m256 __sigmoid_ps(const __m256 x) {
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    return _mm256_div_ps(one, _mm256_add_ps(one, __exp_ps(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+
+}
+
+// tanh(x) = 2 * sigmoid(2x) - 1
+static inline NATIVE_AVX2_TARGET __m256 __tanh_ps(const __m256 x) {
+
+    const __m256 two = _mm256_set1_ps(2.0f);
+    return _mm256_fmsub_ps(two, __sigmoid_ps(_mm256_mul_ps(two, x)), _mm256_set1_ps(1.0f));
+
+}
+
+// 以下AVX2版本处理8的整数倍部分, 返回已处理的数量, 其余由标量实现完成
+static NATIVE_AVX2_TARGET uint32_t __gru_update_avx2(const float * __restrict__ gi, const float * __restrict__ gh, float * __restrict__ h, const uint32_t H) {
+
+    uint32_t j = 0;
+
+    for (; j + 8 <= H; j += 8) {
+        const __m256 r_g = __sigmoid_ps(_mm256_add_ps(_mm256_loadu_ps(gi + j), _mm256_loadu_ps(gh + j)));
+        const __m256 z_g = __sigmoid_ps(_mm256_add_ps(_mm256_loadu_ps(gi + H + j), _mm256_loadu_ps(gh + H + j)));
+        const __m256 n_g = __tanh_ps(_mm256_fmadd_ps(r_g, _mm256_loadu_ps(gh + 2 * H + j), _mm256_loadu_ps(gi + 2 * H + j)));
+        _mm256_storeu_ps(h + j, _mm256_fmadd_ps(z_g, _mm256_sub_ps(_mm256_loadu_ps(h + j), n_g), n_g));
+    }
+
+    return j;
+
+}
+
+static NATIVE_AVX2_TARGET uint32_t __lstm_update_avx2(const float * __restrict__ gi, const float * __restrict__ gh, float * __restrict__ h, float * __restrict__ c, const uint32_t H) {
+
+    uint32_t j = 0;
+
+    for (; j + 8 <= H; j += 8) {
+        const __m256 i_g = __sigmoid_ps(_mm256_add_ps(_mm256_loadu_ps(gi + j), _mm256_loadu_ps(gh + j)));
+        const __m256 f_g = __sigmoid_ps(_mm256_add_ps(_mm256_loadu_ps(gi + H + j), _mm256_loadu_ps(gh + H + j)));
+        const __m256 g_g = __tanh_ps(_mm256_add_ps(_mm256_loadu_ps(gi + 2 * H + j), _mm256_loadu_ps(gh + 2 * H + j)));
+        const __m256 o_g = __sigmoid_ps(_mm256_add_ps(_mm256_loadu_ps(gi + 3 * H + j), _mm256_loadu_ps(gh + 3 * H + j)));
+        const __m256 c_new = _mm256_fmadd_ps(f_g, _mm256_loadu_ps(c + j), _mm256_mul_ps(i_g, g_g));
+        _mm256_storeu_ps(c + j, c_new);
+        _mm256_storeu_ps(h + j, _mm256_mul_ps(o_g, __tanh_ps(c_new)));
+    }
+
+    return j;
+
+}
+
+static NATIVE_AVX2_TARGET uint32_t __axpy_avx2(const float a, const float * __restrict__ w, float * __restrict__ y, const uint32_t len) {
+
+    uint32_t i = 0;
+
+    const __m256 va = _mm256_set1_ps(a);
+    for (; i + 8 <= len; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(w + i), _mm256_loadu_ps(y + i)));
+    }
+
+    return i;
+
+}
+
+// 每次处理2行 x 32列, 累加器常驻寄存器, 每个w_t块被两行复用; 返回已处理的行数
+static NATIVE_AVX2_TARGET uint32_t __gemm_rows_avx2(const float * __restrict__ x, const uint32_t rows, const uint32_t in_dim,
+                                                    const float * __restrict__ w_t, const float * __restrict__ b, const uint32_t out_dim,
+                                                    float * __restrict__ y) {
+
+    uint32_t r = 0;
+
+    const uint32_t block_end = out_dim & ~31u;
+
+    for (; r + 2 <= rows; r += 2) {
+
+        const float * x0 = x + static_cast<size_t >(r) * in_dim;
+        const float * x1 = x0 + in_dim;
+        float * y0 = y + static_cast<size_t >(r) * out_dim;
+        float * y1 = y0 + out_dim;
+
+        uint32_t g = 0;
+
+        for (; g < block_end; g += 32) {
+
+            __m256 a00 = _mm256_loadu_ps(b + g), a01 = _mm256_loadu_ps(b + g + 8);
+            __m256 a02 = _mm256_loadu_ps(b + g + 16), a03 = _mm256_loadu_ps(b + g + 24);
+            __m256 a10 = a00, a11 = a01, a12 = a02, a13 = a03;
+
+            for (uint32_t k = 0; k < in_dim; k ++) {
+
+                const float * w = w_t + static_cast<size_t >(k) * out_dim + g;
+                const __m256 w0 = _mm256_loadu_ps(w), w1 = _mm256_loadu_ps(w + 8);
+                const __m256 w2 = _mm256_loadu_ps(w + 16), w3 = _mm256_loadu_ps(w + 24);
+                const __m256 v0 = _mm256_set1_ps(x0[k]), v1 = _mm256_set1_ps(x1[k]);
+
+                a00 = _mm256_fmadd_ps(v0, w0, a00); a01 = _mm256_fmadd_ps(v0, w1, a01);
+                a02 = _mm256_fmadd_ps(v0, w2, a02); a03 = _mm256_fmadd_ps(v0, w3, a03);
+                a10 = _mm256_fmadd_ps(v1, w0, a10); a11 = _mm256_fmadd_ps(v1, w1, a11);
+                a12 = _mm256_fmadd_ps(v1, w2, a12); a13 = _mm256_fmadd_ps(v1, w3, a13);
+
+            }
+
+            _mm256_storeu_ps(y0 + g, a00); _mm256_storeu_ps(y0 + g + 8, a01);
+            _mm256_storeu_ps(y0 + g + 16, a02); _mm256_storeu_ps(y0 + g + 24, a03);
+            _mm256_storeu_ps(y1 + g, a10); _mm256_storeu_ps(y1 + g + 8, a11);
+            _mm256_storeu_ps(y1 + g + 16, a12); _mm256_storeu_ps(y1 + g + 24, a13);
+
+        }
+
+        for (; g < out_dim; g ++) {
+
+            float s0 = b[g], s1 = b[g];
+
+            for (uint32_t k = 0; k < in_dim; k ++) {
+                const float w = w_t[static_cast<size_t >(k) * out_dim + g];
+                s0 += x0[k] * w;
+                s1 += x1[k] * w;
+            }
+
+            y0[g] = s0;
+            y1[g] = s1;
+
+        }
+
+    }
+
+    return r;
+
+}
+
+#endif
+
+// GRU: r = σ(gi_r + gh_r), z = σ(gi_z + gh_z), n = tanh(gi_n + r * gh_n), h = (1 - z) * n + z * h
+static inline void __gru_update(const float * __restrict__ gi, const float * __restrict__ gh, float * __restrict__ h, const uint32_t H) {
+
+    uint32_t j = 0;
+
+#ifdef NATIVE_AVX2_KERNELS
+    if (__use_avx2) j = __gru_update_avx2(gi, gh, h, H);
+#endif
+
+    for (; j < H; j ++) {
+        const float r_g = __sigmoid(gi[j] + gh[j]);
+        const float z_g = __sigmoid(gi[H + j] + gh[H + j]);
+        const float n_g = tanhf(gi[2 * H + j] + r_g * gh[2 * H + j]);
+        h[j] = (1.0f - z_g) * n_g + z_g * h[j];
+    }
+
+}
+
+// LSTM: i, f, o = σ(...), g = tanh(...), c = f * c + i * g, h = o * tanh(c)
+static inline void __lstm_update(const float * __restrict__ gi, const float * __restrict__ gh, float * __restrict__ h, float * __restrict__ c, const uint32_t H) {
+
+    uint32_t j = 0;
+
+#ifdef NATIVE_AVX2_KERNELS
+    if (__use_avx2) j = __lstm_update_avx2(gi, gh, h, c, H);
+#endif
+
+    for (; j < H; j ++) {
+        const float i_g = __sigmoid(gi[j] + gh[j]);
+        const float f_g = __sigmoid(gi[H + j] + gh[H + j]);
+        const float g_g = tanhf(gi[2 * H + j] + gh[2 * H + j]);
+        const float o_g = __sigmoid(gi[3 * H + j] + gh[3 * H + j]);
+        c[j] = f_g * c[j] + i_g * g_g;
+        h[j] = o_g * tanhf(c[j]);
+    }
+
+}
+
+// y[0, len) += a * w[0, len)
+static inline void native_axpy(const float a, const float * __restrict__ w, float * __restrict__ y, const uint32_t len) {
+
+    uint32_t i = 0;
+
+#ifdef NATIVE_AVX2_KERNELS
+    if (__use_avx2) i = __axpy_avx2(a, w, y, len);
+#endif
+
+    for (; i < len; i ++) y[i] += a * w[i];
+
+}
+
+// y[rows][out_dim] = x[rows][in_dim] * w_t[in_dim][out_dim] + b
+// AVX2: 成对的行由__gemm_rows_avx2处理; 其余部分按行做axpy
+static inline void native_gemm_rows(const float * __restrict__ x, const uint32_t rows, const uint32_t in_dim,
+                                    const float * __restrict__ w_t, const float * __restrict__ b, const uint32_t out_dim,
+                                    float * __restrict__ y) {
+
+    uint32_t r = 0;
+
+#ifdef NATIVE_AVX2_KERNELS
+    if (__use_avx2) r = __gemm_rows_avx2(x, rows, in_dim, w_t, b, out_dim, y);
+#endif
+
+    for (; r < rows; r ++) {
+
+        const float * x_r = x + static_cast<size_t >(r) * in_dim;
+        float * y_r = y + static_cast<size_t >(r) * out_dim;
+
+        memcpy(y_r, b, out_dim * sizeof(float));
+
+        for (uint32_t k = 0; k < in_dim; k ++) native_axpy(x_r[k], w_t + static_cast<size_t >(k) * out_dim, y_r, out_dim);
+
+    }
+
+}
+
+// torch的[rows][cols]权重转置为[cols][rows]
+static void __load_transposed(const torch::Tensor & w, vector<float > & w_t) {
+
+    const torch::Tensor _w = w.to(torch::kFloat32).contiguous();
+    const float * data = _w.data_ptr<float >();
+
+    const int64_t rows = _w.size(0), cols = _w.size(1);
+
+    w_t.resize(rows * cols);
+
+    for (int64_t r = 0; r < rows; r ++) {
+        for (int64_t c = 0; c < cols; c ++) w_t[c * rows + r] = data[r * cols + c];
+    }
+
+}
+
+static void __load_vector(const torch::Tensor & v, vector<float > & out) {
+
+    const torch::Tensor _v = v.to(torch::kFloat32).contiguous();
+    out.assign(_v.data_ptr<float >(), _v.data_ptr<float >() + _v.numel());
+
+}
+
+torch::Tensor TorchScriptBackend::forward(const torch::Tensor & input) {
+
+    inference_inputs.push_back(input);
+    torch::jit::IValue res = p_model->forward(inference_inputs);
+    inference_inputs.clear();
+
+    return res.isTensor() ? res.toTensor() : torch::Tensor();
+
+}
+
+void NativeRNNModel::load(const torch::jit::script::Module & module, const string & path) {
+
+    rnn_layers.clear();
+    linear_layers.clear();
+
+    // 按参数出现的顺序收集各层, rnn层以"<prefix>#<layer>"区分
+    vector<string > rnn_keys, linear_keys;
+    unordered_map<string, unordered_map<string, torch::Tensor > > rnn_params, linear_params;
+
+    for (const auto & _p : module.named_parameters(true)) {
+
+        const size_t _pos = _p.name.rfind('.');
+        const string prefix = _pos == string::npos ? "" : _p.name.substr(0, _pos);
+        const string attr = _pos == string::npos ? _p.name : _p.name.substr(_pos + 1);
+
+        if (attr.find("_reverse") != string::npos) {
+
+            FATAL_ERROR("Native Backend Does Not Support Bidirectional RNN (" + path + ": " + _p.name + ").");
+
+        }
+
+        const size_t _l = attr.rfind("_l");
+
+        if (_l != string::npos && (attr.compare(0, 7, "weight_") == 0 || attr.compare(0, 5, "bias_") == 0)) {
+
+            const string key = prefix + "#" + attr.substr(_l + 2);
+            if (!rnn_params.count(key)) rnn_keys.push_back(key);
+            rnn_params[key][attr.substr(0, _l)] = _p.value;
+
+        } else if (attr == "weight" || attr == "bias") {
+
+            if (!linear_params.count(prefix)) linear_keys.push_back(prefix);
+            linear_params[prefix][attr] = _p.value;
+
+        } else {
+
+            FATAL_ERROR("Native Backend Does Not Support Parameter " + _p.name + " (" + path + ").");
+
+        }
+
+    }
+
+    for (const auto & key : rnn_keys) {
+
+        auto & params = rnn_params[key];
+
+        if (!params.count("weight_ih") || !params.count("weight_hh")) FATAL_ERROR("Incomplete RNN Layer " + key + " (" + path + ").");
+
+        RNNLayer layer;
+        layer.hidden = params["weight_hh"].size(1);
+        layer.in_dim = params["weight_ih"].size(1);
+        layer.gate_num = params["weight_ih"].size(0) / layer.hidden;
+
+        if (layer.gate_num == 3) layer.lstm = false;
+        else if (layer.gate_num == 4) layer.lstm = true;
+        else FATAL_ERROR("Native Backend Only Supports GRU/LSTM Layers (" + path + ": " + key + ").");
+
+        const uint32_t G = layer.gate_num * layer.hidden;
+
+        __load_transposed(params["weight_ih"], layer.w_ih_t);
+        __load_transposed(params["weight_hh"], layer.w_hh_t);
+
+        if (params.count("bias_ih")) __load_vector(params["bias_ih"], layer.b_ih);
+        else layer.b_ih.assign(G, 0.0f);
+
+        if (params.count("bias_hh")) __load_vector(params["bias_hh"], layer.b_hh);
+        else layer.b_hh.assign(G, 0.0f);
+
+        if (!rnn_layers.empty() && rnn_layers.back().hidden != layer.in_dim) FATAL_ERROR("Mismatched RNN Layer " + key + " (" + path + ").");
+
+        rnn_layers.push_back(move(layer));
+
+    }
+
+    if (rnn_layers.empty()) FATAL_ERROR("No GRU/LSTM Layer Found in " + path + ".");
+
+    for (const auto & key : linear_keys) {
+
+        auto & params = linear_params[key];
+
+        if (!params.count("weight") || params["weight"].dim() != 2) FATAL_ERROR("Native Backend Only Supports Linear Layers (" + path + ": " + key + ").");
+
+        LinearLayer layer;
+        layer.out_dim = params["weight"].size(0);
+        layer.in_dim = params["weight"].size(1);
+
+        __load_transposed(params["weight"], layer.w_t);
+
+        if (params.count("bias")) __load_vector(params["bias"], layer.b);
+        else layer.b.assign(layer.out_dim, 0.0f);
+
+        const uint32_t prev_dim = linear_layers.empty() ? rnn_layers.back().hidden : linear_layers.back().out_dim;
+        if (prev_dim != layer.in_dim) FATAL_ERROR("Mismatched Linear Layer " + key + " (" + path + ").");
+
+        linear_layers.push_back(move(layer));
+
+    }
+
+    check_parity(module, path);
+
+}
+
+void NativeRNNModel::check_parity(const torch::jit::script::Module & module, const string & path) const {
+
+    // 参数名只给出各层的形状, 模块实际的forward(输出头, 激活, 规约)由探测批的输出确认
+    const int64_t n = 4, seq_len = 32;
+
+    c10::InferenceMode inference_guard;
+
+    torch::jit::script::Module probe_module = module.clone();
+    probe_module.eval();
+    probe_module.to(torch::kFloat32);
+
+    // 确定性的探测输入, 取值在[-1, 1]内
+    const torch::Tensor probe = torch::sin(torch::arange(n * seq_len * input_dim(), torch::TensorOptions().dtype(torch::kFloat32)) * 0.37f)
+                                    .view({n, seq_len, static_cast<int64_t >(input_dim())}).contiguous();
+
+    const torch::jit::IValue res = probe_module.forward({probe});
+
+    if (!res.isTensor()) FATAL_ERROR("Output of Model " + path + " is Not a Tensor, Native Backend Cannot Reproduce It.");
+
+    const torch::Tensor torch_out = res.toTensor().to(torch::kFloat32);
+
+    torch::Tensor native_out = torch::empty({n, static_cast<int64_t >(output_dim())}, torch::TensorOptions().dtype(torch::kFloat32));
+
+    Workspace ws;
+    forward(probe.data_ptr<float >(), n, seq_len, native_out.data_ptr<float >(), ws);
+
+    if (native_out.sizes() != torch_out.sizes()) {
+
+        FATAL_ERROR("Output Shape of Model " + path + " Differs from the Native Backend (Unsupported Model Structure).");
+
+    }
+
+    if (!within_parity(native_out, torch_out)) {
+
+        const double_t max_abs_dev = (native_out - torch_out).abs().max().item<double_t >();
+        FATAL_ERROR("Output of Model " + path + " Deviates from the Native Backend by " + to_string(max_abs_dev) + " (Unsupported Model Structure).");
+
+    }
+
+}
+
+void NativeRNNModel::forward(const float * in, const uint32_t n, const uint32_t seq_len, float * out, Workspace & ws) const {
+
+    const float * x = in;
+
+    for (size_t l = 0; l < rnn_layers.size(); l ++) {
+
+        const RNNLayer & layer = rnn_layers[l];
+
+        const uint32_t H = layer.hidden;
+        const uint32_t G = layer.gate_num * H;
+        const bool last_layer = (l + 1 == rnn_layers.size());
+
+        // 所有时刻的输入投影一次算完
+        ws.gi.resize(static_cast<size_t >(n) * seq_len * G);
+        native_gemm_rows(x, n * seq_len, layer.in_dim, layer.w_ih_t.data(), layer.b_ih.data(), G, ws.gi.data());
+
+        ws.gh.resize(static_cast<size_t >(n) * G);
+        ws.h.assign(static_cast<size_t >(n) * H, 0.0f);
+        if (layer.lstm) ws.c.assign(static_cast<size_t >(n) * H, 0.0f);
+
+        vector<float > & seq_out = ws.seq[l & 1];
+        if (!last_layer) seq_out.resize(static_cast<size_t >(n) * seq_len * H);
+
+        for (uint32_t t = 0; t < seq_len; t ++) {
+
+            native_gemm_rows(ws.h.data(), n, H, layer.w_hh_t.data(), layer.b_hh.data(), G, ws.gh.data());
+
+            for (uint32_t b = 0; b < n; b ++) {
+
+                const float * gi = ws.gi.data() + (static_cast<size_t >(b) * seq_len + t) * G;
+                const float * gh = ws.gh.data() + static_cast<size_t >(b) * G;
+                float * h = ws.h.data() + static_cast<size_t >(b) * H;
+
+                if (layer.lstm) __lstm_update(gi, gh, h, ws.c.data() + static_cast<size_t >(b) * H, H);
+                else __gru_update(gi, gh, h, H);
+
+                if (!last_layer) memcpy(seq_out.data() + (static_cast<size_t >(b) * seq_len + t) * H, h, H * sizeof(float));
+
+            }
+
+        }
+
+        x = seq_out.data();
+
+    }
+
+    // 最后时刻的隐状态经过Linear层
+    forward_head(ws.h.data(), n, out, ws);
+
+}
+
+void NativeRNNModel::forward_head(const float * h, const uint32_t n, float * out, Workspace & ws) const {
+
+    const float * cur = h;
+    uint32_t cur_dim = rnn_layers.back().hidden;
+
+    for (size_t k = 0; k < linear_layers.size(); k ++) {
+
+        const LinearLayer & layer = linear_layers[k];
+        vector<float > & next = ws.head[k & 1];
+
+        next.resize(static_cast<size_t >(n) * layer.out_dim);
+        native_gemm_rows(cur, n, cur_dim, layer.w_t.data(), layer.b.data(), layer.out_dim, next.data());
+
+        if (k + 1 < linear_layers.size()) {
+            for (auto & _v : next) _v = max(_v, 0.0f);
+        }
+
+        cur = next.data();
+        cur_dim = layer.out_dim;
+
+    }
+
+    memcpy(out, cur, static_cast<size_t >(n) * cur_dim * sizeof(float));
+
+}
+
+void NativeRNNModel::reset_state(StreamState & state) const {
+
+    size_t state_size = 0;
+    for (const auto & layer : rnn_layers) state_size += layer.hidden;
+
+    state.h.assign(state_size, 0.0f);
+    state.c.assign(state_size, 0.0f);
+    state.steps = 0;
+
+}
+
+int64_t NativeRNNModel::stream(const float * const * rows, const uint32_t * lens, StreamState * const * states, const uint32_t n,
+                                const uint32_t slice_len, const uint32_t stride, float * out, Workspace & ws) const {
+
+    // 各序列的行与窗口输出在工作区中的偏移
+    ws.row_off.resize(n + 1);
+    ws.emit_off.resize(n + 1);
+    ws.row_off[0] = ws.emit_off[0] = 0;
+
+    uint32_t max_len = 0;
+
+    for (uint32_t b = 0; b < n; b ++) {
+        ws.row_off[b + 1] = ws.row_off[b] + lens[b];
+        ws.emit_off[b + 1] = ws.emit_off[b] + window_num(states[b]->steps + lens[b], slice_len, stride) - window_num(states[b]->steps, slice_len, stride);
+        max_len = max(max_len, lens[b]);
+    }
+
+    const size_t row_num = ws.row_off[n];
+    const size_t emit_num = ws.emit_off[n];
+
+    // 按长度降序排列, 第t步仍未结束的序列恰为前active条, 隐状态投影只需计算这些行
+    ws.order.resize(n);
+    for (uint32_t b = 0; b < n; b ++) ws.order[b] = b;
+    sort(ws.order.begin(), ws.order.end(), [&] (const size_t _a, const size_t _b) {return lens[_a] > lens[_b];});
+
+    ws.emit.resize(emit_num * rnn_layers.back().hidden);
+
+    const float * x = nullptr;
+    uint32_t state_off = 0;
+
+    for (size_t l = 0; l < rnn_layers.size(); l ++) {
+
+        const RNNLayer & layer = rnn_layers[l];
+
+        const uint32_t H = layer.hidden;
+        const uint32_t G = layer.gate_num * H;
+        const bool last_layer = (l + 1 == rnn_layers.size());
+
+        // 每条序列新增的行一次算完输入投影
+        ws.gi.resize(row_num * G);
+        for (uint32_t b = 0; b < n; b ++) {
+            const float * x_b = (l == 0) ? rows[b] : x + ws.row_off[b] * layer.in_dim;
+            native_gemm_rows(x_b, lens[b], layer.in_dim, layer.w_ih_t.data(), layer.b_ih.data(), G, ws.gi.data() + ws.row_off[b] * G);
+        }
+
+        // 按排序后的顺序装载各序列的状态
+        ws.gh.resize(static_cast<size_t >(n) * G);
+        ws.h.resize(static_cast<size_t >(n) * H);
+        ws.c.resize(static_cast<size_t >(n) * H);
+
+        for (uint32_t i = 0; i < n; i ++) {
+            const StreamState & state = *states[ws.order[i]];
+            memcpy(ws.h.data() + static_cast<size_t >(i) * H, state.h.data() + state_off, H * sizeof(float));
+            if (layer.lstm) memcpy(ws.c.data() + static_cast<size_t >(i) * H, state.c.data() + state_off, H * sizeof(float));
+        }
+
+        vector<float > & seq_out = ws.seq[l & 1];
+        if (!last_layer) seq_out.resize(row_num * H);
+
+        uint32_t active = n;
+
+        for (uint32_t t = 0; t < max_len; t ++) {
+
+            while (active > 0 && lens[ws.order[active - 1]] <= t) active --;
+
+            native_gemm_rows(ws.h.data(), active, H, layer.w_hh_t.data(), layer.b_hh.data(), G, ws.gh.data());
+
+            for (uint32_t i = 0; i < active; i ++) {
+
+                const size_t b = ws.order[i];
+
+                const float * gi = ws.gi.data() + (ws.row_off[b] + t) * G;
+                const float * gh = ws.gh.data() + static_cast<size_t >(i) * G;
+                float * h = ws.h.data() + static_cast<size_t >(i) * H;
+
+                if (layer.lstm) __lstm_update(gi, gh, h, ws.c.data() + static_cast<size_t >(i) * H, H);
+                else __gru_update(gi, gh, h, H);
+
+                if (!last_layer) {
+
+                    memcpy(seq_out.data() + (ws.row_off[b] + t) * H, h, H * sizeof(float));
+
+                } else {
+
+                    const uint64_t _s = states[b]->steps + t + 1;
+
+                    if (_s >= slice_len && (_s - slice_len) % stride == 0) {
+                        const size_t _k = ws.emit_off[b] + window_num(_s, slice_len, stride) - window_num(states[b]->steps, slice_len, stride) - 1;
+                        memcpy(ws.emit.data() + _k * H, h, H * sizeof(float));
+                    }
+
+                }
+
+            }
+
+        }
+
+        for (uint32_t i = 0; i < n; i ++) {
+            StreamState & state = *states[ws.order[i]];
+            memcpy(state.h.data() + state_off, ws.h.data() + static_cast<size_t >(i) * H, H * sizeof(float));
+            if (layer.lstm) memcpy(state.c.data() + state_off, ws.c.data() + static_cast<size_t >(i) * H, H * sizeof(float));
+        }
+
+        x = seq_out.data();
+        state_off += H;
+
+    }
+
+    for (uint32_t b = 0; b < n; b ++) states[b]->steps += lens[b];
+
+    if (emit_num > 0) forward_head(ws.emit.data(), emit_num, out, ws);
+
+    return emit_num;
+
+}
+
+torch::Tensor NativeRNNBackend::forward(const torch::Tensor & input) {
+
+    const torch::Tensor x = input.to(torch::kFloat32).contiguous();
+
+    const uint32_t n = x.size(0), seq_len = x.size(1);
+
+    if (x.size(2) != p_model->input_dim()) {
+
+        FATAL_ERROR("Input Dimension of Native Backend Mismatches the Model.");
+
+    }
+
+    torch::Tensor out = torch::empty({static_cast<int64_t >(n), static_cast<int64_t >(p_model->output_dim())}, torch::TensorOptions().dtype(torch::kFloat32));
+
+    p_model->forward(x.data_ptr<float >(), n, seq_len, out.data_ptr<float >(), ws);
+
+    return input.scalar_type() == torch::kFloat32 ? out : out.to(input.scalar_type());
+
+}
+
+torch::Tensor NativeRNNBackend::forward_stream(const torch::Tensor & rows, const vector<int64_t > & row_nums, const uint32_t slice_len, const uint32_t stride,
+                                                const vector<RNNStreamState * > & states) {
+
+    const torch::Tensor x = rows.to(torch::kFloat32).contiguous();
+
+    if (x.size(1) != p_model->input_dim()) {
+
+        FATAL_ERROR("Input Dimension of Native Backend Mismatches the Model.");
+
+    }
+
+    const uint32_t n = row_nums.size();
+
+    stream_states.resize(n);
+
+    vector<const float * > row_ptrs(n);
+    vector<uint32_t > lens(n);
+    vector<NativeRNNModel::StreamState * > state_ptrs(n);
+
+    int64_t offset = 0, window_num = 0;
+
+    for (uint32_t b = 0; b < n; b ++) {
+        state_ptrs[b] = (b < states.size() && states[b]) ? states[b] : &stream_states[b];
+        if (state_ptrs[b] == &stream_states[b] || state_ptrs[b]->h.empty()) p_model->reset_state(*state_ptrs[b]);
+        row_ptrs[b] = x.data_ptr<float >() + offset * p_model->input_dim();
+        lens[b] = row_nums[b];
+        offset += row_nums[b];
+        const uint64_t _steps = state_ptrs[b]->steps;
+        window_num += NativeRNNModel::window_num(_steps + row_nums[b], slice_len, stride) - NativeRNNModel::window_num(_steps, slice_len, stride);
+    }
+
+    torch::Tensor out = torch::empty({window_num, static_cast<int64_t >(p_model->output_dim())}, torch::TensorOptions().dtype(torch::kFloat32));
+
+    p_model->stream(row_ptrs.data(), lens.data(), state_ptrs.data(), n, slice_len, stride, out.data_ptr<float >(), ws);
+
+    return rows.scalar_type() == torch::kFloat32 ? out : out.to(rows.scalar_type());
+
+}
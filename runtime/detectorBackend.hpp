@@ -0,0 +1,171 @@
+#pragma once
+
+#include <torch/torch.h>
+#include <torch/script.h>
+#include "dpdkAppUtility.hpp"
+
+namespace Reaper
+{
+
+// 一条序列的流式推断状态: 各RNN层的h/c依次拼接, 以及已经处理的行数; h为空表示尚未开始
+struct RNNStreamState {
+    vector<float > h, c;
+    uint64_t steps = 0;
+};
+
+// detector推断后端: 输入为一个批的slices [n, slice_len, 3], 输出首维与slice一一对应
+class DetectorBackend {
+
+public:
+
+    virtual ~DetectorBackend() {}
+
+    virtual const char * name() const = 0;
+
+    // 模型输出不是tensor时返回未定义的tensor
+    virtual torch::Tensor forward(const torch::Tensor & input) = 0;
+
+    // 是否支持有状态的流式推断 (forward_stream)
+    virtual bool streaming() const {return false;}
+
+    // 流式推断: rows为多条序列依次拼接的[sum(row_nums), 3], 每条序列只经过模型一次, 
+    // 隐状态沿序列传递, 在每个窗口(长度slice_len, 步长stride)结束时输出, 输出行数与unfold得到的slice数一致
+    // states为空时每条序列从头开始; 否则第b条序列从states[b]续接(空指针或尚未开始的状态从头开始), 调用后states[b]推进row_nums[b]行,
+    // 此时只输出本次新增行中结束的窗口
+    virtual torch::Tensor forward_stream(const torch::Tensor & rows, const vector<int64_t > & row_nums, const uint32_t slice_len, const uint32_t stride,
+                                            const vector<RNNStreamState * > & states) {
+        FATAL_ERROR(string("Backend ") + name() + " Does Not Support Streaming Inference.");
+        return torch::Tensor();
+    }
+
+};
+
+// libtorch后端: 共享ModelRegistry中的TorchScript模块
+class TorchScriptBackend final : public DetectorBackend {
+
+private:
+
+    shared_ptr<torch::jit::script::Module > p_model;
+
+    vector<torch::jit::IValue > inference_inputs; // 临时变量
+
+public:
+
+    explicit TorchScriptBackend(const shared_ptr<torch::jit::script::Module > & _p): p_model(_p) {}
+
+    virtual const char * name() const override {return "torchscript";}
+
+    virtual torch::Tensor forward(const torch::Tensor & input) override;
+
+};
+
+// 原生RNN模型: 由TorchScript模型的参数构造, 支持batch_first的单向GRU/LSTM层,
+// 以及作用于最后时刻隐状态的Linear层(层间ReLU); 以float32计算, 加载后只读, 可被多个detector共享
+class NativeRNNModel final {
+
+public:
+
+    struct RNNLayer {
+        bool lstm = false;
+        uint32_t in_dim = 0;
+        uint32_t hidden = 0;
+        uint32_t gate_num = 0; // GRU: 3 (r, z, n), LSTM: 4 (i, f, g, o)
+        vector<float > w_ih_t; // [in_dim][gate_num * hidden], 转置后按门连续存放
+        vector<float > w_hh_t; // [hidden][gate_num * hidden]
+        vector<float > b_ih;
+        vector<float > b_hh;
+    };
+
+    struct LinearLayer {
+        uint32_t in_dim = 0;
+        uint32_t out_dim = 0;
+        vector<float > w_t; // [in_dim][out_dim]
+        vector<float > b;
+    };
+
+    // 每个调用线程私有的中间结果, 反复使用以避免分配
+    struct Workspace {
+        vector<float > seq[2]; // 非最后一层的逐时刻输出 [n, seq_len, hidden]
+        vector<float > gi;     // 输入投影 [n, seq_len, gate_num * hidden]
+        vector<float > gh;     // 隐状态投影 [n, gate_num * hidden]
+        vector<float > h, c;   // [n, hidden]
+        vector<float > head[2];
+        vector<float > emit;   // 流式推断中各窗口结束时刻最后一层的隐状态
+        vector<size_t > order, row_off, emit_off;
+    };
+
+    using StreamState = RNNStreamState;
+
+    vector<RNNLayer > rnn_layers;
+    vector<LinearLayer > linear_layers;
+
+    // 与TorchScript模块输出的容差: |native - torch| <= PARITY_ATOL + PARITY_RTOL * |torch|
+    static constexpr double_t PARITY_RTOL = 1e-3;
+    static constexpr double_t PARITY_ATOL = 1e-4;
+
+    static inline bool within_parity(const torch::Tensor & native_out, const torch::Tensor & torch_out) {
+        return native_out.sizes() == torch_out.sizes() && 
+                torch::allclose(native_out.to(torch::kFloat64), torch_out.to(torch::kFloat64), PARITY_RTOL, PARITY_ATOL);
+    }
+
+    // 解析named_parameters, 不支持的结构(双向, 普通RNN, 其他带参数的层)直接报错; 
+    // 之后以探测批比较模块的forward与原生实现, 输出形状不同或偏差超过容差(输出头, 激活或规约不同)时同样报错
+    void load(const torch::jit::script::Module & module, const string & path);
+
+    uint32_t input_dim() const {return rnn_layers.front().in_dim;}
+
+    uint32_t output_dim() const {return linear_layers.empty() ? rnn_layers.back().hidden : linear_layers.back().out_dim;}
+
+    // in: [n, seq_len, input_dim], out: [n, output_dim]
+    void forward(const float * in, const uint32_t n, const uint32_t seq_len, float * out, Workspace & ws) const;
+
+    // 清零隐状态, 开始一条新序列
+    void reset_state(StreamState & state) const;
+
+    // 已处理steps行的序列此前输出过的窗口数
+    static inline uint64_t window_num(const uint64_t steps, const uint32_t slice_len, const uint32_t stride) {
+        return steps < slice_len ? 0 : (steps - slice_len) / stride + 1;
+    }
+
+    // 把n条序列各自的状态推进lens[b]行(rows[b]: [lens[b], input_dim]), 各序列可在多次调用间分段到达;
+    // 第b条序列新增的窗口输出依次写入out, 序列之间按输入顺序排列, 返回输出总行数
+    int64_t stream(const float * const * rows, const uint32_t * lens, StreamState * const * states, const uint32_t n,
+                    const uint32_t slice_len, const uint32_t stride, float * out, Workspace & ws) const;
+
+private:
+
+    void check_parity(const torch::jit::script::Module & module, const string & path) const;
+
+    // 隐状态 h: [n, hidden] 经过Linear层(层间ReLU)写入out
+    void forward_head(const float * h, const uint32_t n, float * out, Workspace & ws) const;
+
+};
+
+// 原生后端: 共享只读的NativeRNNModel, 工作区为后端私有
+class NativeRNNBackend final : public DetectorBackend {
+
+private:
+
+    shared_ptr<const NativeRNNModel > p_model;
+
+    NativeRNNModel::Workspace ws;
+
+    // forward_stream中未给出状态的序列使用的临时状态(每次调用重新开始)
+    vector<NativeRNNModel::StreamState > stream_states;
+
+public:
+
+    explicit NativeRNNBackend(const shared_ptr<const NativeRNNModel > & _p): p_model(_p) {}
+
+    virtual const char * name() const override {return "native";}
+
+    virtual torch::Tensor forward(const torch::Tensor & input) override;
+
+    virtual bool streaming() const override {return true;}
+
+    virtual torch::Tensor forward_stream(const torch::Tensor & rows, const vector<int64_t > & row_nums, const uint32_t slice_len, const uint32_t stride,
+                                            const vector<RNNStreamState * > & states) override;
+
+};
+
+}
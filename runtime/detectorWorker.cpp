@@ -12,17 +12,29 @@ static inline double_t __get_double_ts() {
 
 bool DetectorWorkerThread::run(uint32_t coreId) {
 
-	// 加载rnn模型
-	long_model = torch::jit::load(p_detector_param->long_model_path);
-	long_model.eval();
+	m_stop = false;
+	m_core_id = coreId;
+
+	configure_torch_threads();
+
+	if (p_long_backend == nullptr || p_aggr_backend == nullptr) {
+
+		FATAL_ERROR("Models of Detector are Not Loaded.");
+
+	}
+
+	// 本线程上的推断都不记录autograd信息, 批缓冲也创建为inference tensor
+	c10::InferenceMode inference_guard;
 
-	aggr_model = torch::jit::load(p_detector_param->aggr_model_path);
-	aggr_model.eval();
+	prepare_buffers();
 
 	LOGF("Detector on Core #%d Start", coreId);
 
-	m_stop = false;
-	m_core_id = coreId;
+	if (p_work_queue[0] == nullptr || p_work_queue[1] == nullptr) {
+
+		FATAL_ERROR("Work Queues of Detector are Not Connected.");
+
+	}
 
 	double_t last_ts = __get_double_ts();
 
@@ -33,6 +45,9 @@ bool DetectorWorkerThread::run(uint32_t coreId) {
 
         if (delta_time > p_detector_param->report_interval) {
 
+            // 所有类别的排队延迟由按类别的分布合并得到
+            for (const auto & _hist : queue_delay_hist) interval_latency_hist[static_cast<uint8_t >(LatencyStage::QUEUEING)].merge(_hist);
+
             if (p_detector_param->tracing_mode) {
 
             	double_t curr_inference_throughput, curr_pre_throughput;
@@ -44,137 +59,792 @@ bool DetectorWorkerThread::run(uint32_t coreId) {
                 else curr_pre_throughput = (((double_t) sum_pre_pkt_len) * 8.0) / pre_active_time / 1e9; 
 
                 LOGF("Detector Throughput on Core #%d: [ %4.5lf Gbps, %4.5lf Gbps ]", coreId, curr_pre_throughput, curr_inference_throughput);
+                LOGF("Detector Batch Size (slices) on Core #%d: %s", coreId, batch_size_hist.to_string().c_str());
+
+                for (size_t k = 0; k < LATENCY_STAGE_NUM; k ++) {
+
+                	LOGF("Detector %s Latency on Core #%d: [ %s ]", 
+                			latency_stage_name(static_cast<LatencyStage >(k)), coreId, interval_latency_hist[k].to_string().c_str());
+
+                }
+
+                const char * class_name[] = {"Long", "Aggr"};
+
+                for (size_t c = 0; c < 2; c ++) {
+
+                	LOGF("Detector Queueing Latency of %s on Core #%d: [ %s ] [ %ld Deadline Misses in %ld ]", 
+                			class_name[c], coreId, queue_delay_hist[c].to_string().c_str(), deadline_miss_num[c], class_mts_num[c]);
+
+                }
+
+                if (p_work_queue[STREAM_SOURCE]) {
+
+                	LOGF("Detector Streaming on Core #%d: [ %ld Chunks, %ld Flows in Progress, %ld Expired ]", 
+                			coreId, stream_chunk_num, stream_state_map.size(), stream_expired_num);
+                	p_work_queue[STREAM_SOURCE]->display_stats("stream_queue");
+
+                }
 
+                if (p_detector_param->prefilter) {
+
+                	const pair<double_t, double_t > cascade = get_cascade_performance();
+
+                	LOGF("Detector Pre-Filter on Core #%d: [ Benign %ld, Alarm %ld, Escalated %ld (%4.2lf%%), Effective %4.5lf Gbps ]", 
+                			coreId, prefilter_benign_num, prefilter_alarm_num, prefilter_escalate_num, cascade.first * 100, cascade.second);
+
+                }
+
+            }
+
+            batch_size_hist.reset();
+            for (size_t k = 0; k < LATENCY_STAGE_NUM; k ++) {
+            	latency_hist[k].merge(interval_latency_hist[k]);
+            	interval_latency_hist[k].reset();
             }
+            for (auto & _hist : queue_delay_hist) _hist.reset();
+
+            if (p_work_queue[STREAM_SOURCE]) expire_stream_states();
 
             last_ts = curr_ts;
 
         }
 
-        for (size_t i = 0; i < p_aggregator_vec.size(); i ++) {
+        schedule_by_deadline();
 
-        	shared_ptr<PktMetaDataArrayOutput > curr_aggr_mts;
+		// 未凑满的批在最早的序列等待超过batch_timeout后提交
+		curr_ts = __get_double_ts();
+		if (!aggr_batch.empty() && curr_ts - aggr_batch.open_ts >= p_detector_param->batch_timeout) flush_batch(aggr_batch, *p_aggr_backend);
+		if (!long_batch.empty() && curr_ts - long_batch.open_ts >= p_detector_param->batch_timeout) flush_batch(long_batch, *p_long_backend);
 
-        	if (p_aggregator_vec[i]->p_short_aggr_queue->try_pop(curr_aggr_mts)) {
+	}
 
-				if (curr_aggr_mts->first->size() >= 3 * p_detector_param->slice_len) {
+	if (!aggr_batch.empty()) flush_batch(aggr_batch, *p_aggr_backend);
+	if (!long_batch.empty()) flush_batch(long_batch, *p_long_backend);
 
-					double_t pre_start_ts = __get_double_ts();
-					torch::Tensor _ten;
+	stream_state_map.clear();
 
-					if (curr_aggr_mts->first->size() >= 3 * p_detector_param->trunc_flow_len) { 
-						
-						_ten = torch::from_blob(curr_aggr_mts->first->data(), {p_detector_param->trunc_flow_len, 3}, torch::kFloat64);
-					
-					} else {
+	for (auto & _hist : queue_delay_hist) {
+		interval_latency_hist[static_cast<uint8_t >(LatencyStage::QUEUEING)].merge(_hist);
+		_hist.reset();
+	}
 
-						uint32_t _len = curr_aggr_mts->first->size() / 3;
+	for (size_t k = 0; k < LATENCY_STAGE_NUM; k ++) {
+		latency_hist[k].merge(interval_latency_hist[k]);
+		interval_latency_hist[k].reset();
+	}
 
-						_ten = torch::from_blob(curr_aggr_mts->first->data(), {_len, 3}, torch::kFloat64);
-				
-					}
+	return true;
 
-					torch::Tensor latter = _ten.index({torch::indexing::Slice(1), 0});
-			        torch::Tensor former = _ten.index({torch::indexing::Slice(0, -1), 0});
+}
 
-		        	torch::Tensor intervals = latter - former;
+void DetectorWorkerThread::configure_torch_threads() {
 
-		        	_ten.index_put_({torch::indexing::Slice(1), 0}, intervals);
-		        	_ten.index_put_({0, 0}, 0);	
+	// OpenMP后端下线程数是调用线程私有的设置, 各detector互不影响
+	torch::set_num_threads(p_detector_param->intra_op_threads);
 
-					torch::Tensor norm_ten = aggr_scale_ * _ten + aggr_min_;
+	if (p_detector_param->intra_op_threads <= 1 || torch_core_set.empty()) return;
 
-					torch::Tensor slices = norm_ten.unfold(0, p_detector_param->slice_len, p_detector_param->stride).permute({0, 2, 1});
+	// OpenMP线程在首个并行区创建并继承创建者的亲和性: 先绑定到torch_core_set, 
+	// 执行一次并行运算创建线程池, 再把detector线程绑回自身的lcore
+	if (!pin_current_thread(torch_core_set)) {
+		WARN("Fail to Pin Intra-Op Threads to Specified Cores.");
+		return;
+	}
 
-					aggr_inference_inputs.push_back(slices);
-					double_t pre_end_ts = __get_double_ts();
+	torch::NoGradGuard no_grad;
+	torch::rand({1 << 20}).sum();
 
-					sum_pre_pkt_len += curr_aggr_mts->second;
-					pre_active_time += (pre_end_ts - pre_start_ts); 
+	if (pin_current_thread(m_core_id)) {
+		LOGF("Intra-Op Threads of Detector on Core #%d are Pinned to %ld Cores", m_core_id, torch_core_set.size());
+	} else {
+		FATAL_ERROR("Fail to Pin Detector Thread back to Its Core.");
+	}
 
-					double_t inference_start_ts = __get_double_ts();
-					torch::jit::IValue res = aggr_model.forward(aggr_inference_inputs);
-					double_t inference_end_ts = __get_double_ts();
+}
 
-					sum_inference_pkt_len += curr_aggr_mts->second;
-					inference_active_time += (inference_end_ts - inference_start_ts); 
-					inference_latency.push_back((inference_end_ts - inference_start_ts));
+shared_ptr<torch::jit::script::Module > ModelRegistry::acquire(const string & path, InferencePrecision precision, bool freeze) {
 
-					// double kl_loss_i = res.toTensor().item<double_t >();
+	lock_guard<mutex> _lock(registry_lock);
 
-					aggr_inference_inputs.clear();
+	const string key = model_key(path, precision, freeze);
 
-				} else {
+	const auto _iter = model_map.find(key);
+	if (_iter != model_map.end()) return _iter->second;
 
-					sum_inference_pkt_len += curr_aggr_mts->second;
-					sum_pre_pkt_len += curr_aggr_mts->second;
+	shared_ptr<torch::jit::script::Module > p_model;
 
-				}
+	try {
 
-			}
+		p_model = make_shared<torch::jit::script::Module >(torch::jit::load(path));
+		p_model->eval();
 
-        }
+		// 量化模型的权重已是int8, 不做转换
+		if (precision != InferencePrecision::INT8) p_model->to(precision_dtype(precision));
 
-        for (size_t j = 0; j < p_inspector_vec.size(); j ++) {
+		if (freeze) {
+			torch::jit::script::Module frozen = torch::jit::freeze(*p_model);
+			*p_model = torch::jit::optimize_for_inference(frozen);
+		}
 
-        	shared_ptr<PktMetaDataArrayOutput > curr_long_mts;
+	} catch (exception & e) {
 
-			if (p_inspector_vec[j]->long_queue.try_pop(curr_long_mts)) {
+		FATAL_ERROR("Fail to Load Model " + path + ": " + e.what());
 
-				double_t pre_start_ts = __get_double_ts();
-				torch::Tensor _ten;
+	}
 
-				if (curr_long_mts->first->size() >= 3 * p_detector_param->trunc_flow_len) { 
-					
-					_ten = torch::from_blob(curr_long_mts->first->data(), {p_detector_param->trunc_flow_len, 3}, torch::kFloat64);
-				
-				} else {
+	LOGF("Model %s Loaded (%s%s).", path.c_str(), precision_name(precision), freeze ? ", Frozen" : "");
 
-					uint32_t _len = curr_long_mts->first->size() / 3;
+	model_map.emplace(key, p_model);
 
-					_ten = torch::from_blob(curr_long_mts->first->data(), {_len, 3}, torch::kFloat64);
-			
-				}
+	return p_model;
 
-				torch::Tensor latter = _ten.index({torch::indexing::Slice(1), 0});
-		        torch::Tensor former = _ten.index({torch::indexing::Slice(0, -1), 0});
+}
 
-	        	torch::Tensor intervals = latter - former;
+shared_ptr<const NativeRNNModel > ModelRegistry::acquire_native(const string & path) {
 
-	        	_ten.index_put_({torch::indexing::Slice(1), 0}, intervals);
-	        	_ten.index_put_({0, 0}, 0);	
+	lock_guard<mutex> _lock(registry_lock);
 
-				torch::Tensor norm_ten = long_scale_ * _ten + long_min_;
+	const string key = native_model_key(path);
 
-				torch::Tensor slices = norm_ten.unfold(0, p_detector_param->slice_len, p_detector_param->stride).permute({0, 2, 1});
+	const auto _iter = native_model_map.find(key);
+	if (_iter != native_model_map.end()) return _iter->second;
 
-				long_inference_inputs.push_back(slices);
-				double_t pre_end_ts = __get_double_ts();
+	shared_ptr<NativeRNNModel > p_model = make_shared<NativeRNNModel >();
 
-				sum_pre_pkt_len += curr_long_mts->second;
-				pre_active_time += (pre_end_ts - pre_start_ts); 
+	try {
 
-				double_t inference_start_ts = __get_double_ts();
-				torch::jit::IValue res = long_model.forward(long_inference_inputs);
-				double_t inference_end_ts = __get_double_ts();
+		torch::jit::script::Module module = torch::jit::load(path);
+		p_model->load(module, path);
 
-				sum_inference_pkt_len += curr_long_mts->second;
-				inference_active_time += (inference_end_ts - inference_start_ts); 	
-				inference_latency.push_back((inference_end_ts - inference_start_ts));
-		
+	} catch (exception & e) {
+
+		FATAL_ERROR("Fail to Load Model " + path + ": " + e.what());
+
+	}
+
+	LOGF("Model %s Loaded (native, %ld RNN Layers, %ld Linear Layers).", path.c_str(), p_model->rnn_layers.size(), p_model->linear_layers.size());
+
+	native_model_map.emplace(key, p_model);
+
+	return p_model;
+
+}
+
+void DetectorWorkerThread::load_models(ModelRegistry & registry) {
+
+	if (p_detector_param->backend == DetectorBackendType::NATIVE) {
+
+		if (p_detector_param->precision == InferencePrecision::INT8) {
+
+			FATAL_ERROR("Native Backend Does Not Support int8 Precision.");
+
+		}
+
+		p_long_backend = make_unique<NativeRNNBackend >(registry.acquire_native(p_detector_param->long_model_path));
+		p_aggr_backend = make_unique<NativeRNNBackend >(registry.acquire_native(p_detector_param->aggr_model_path));
+
+		long_model_key = ModelRegistry::native_model_key(p_detector_param->long_model_path);
+		aggr_model_key = ModelRegistry::native_model_key(p_detector_param->aggr_model_path);
+
+	} else {
+
+		p_long_backend = make_unique<TorchScriptBackend >(registry.acquire(p_detector_param->long_model_path, p_detector_param->precision, p_detector_param->freeze_model));
+		p_aggr_backend = make_unique<TorchScriptBackend >(registry.acquire(p_detector_param->aggr_model_path, p_detector_param->precision, p_detector_param->freeze_model));
+
+		long_model_key = ModelRegistry::model_key(p_detector_param->long_model_path, p_detector_param->precision, p_detector_param->freeze_model);
+		aggr_model_key = ModelRegistry::model_key(p_detector_param->aggr_model_path, p_detector_param->precision, p_detector_param->freeze_model);
+
+	}
+
+	if (p_detector_param->streaming_inference && !(p_long_backend->streaming() && p_aggr_backend->streaming())) {
+
+		FATAL_ERROR("Streaming Inference Requires the Native Backend.");
 
-				// double kl_loss_i = res.toTensor().item<double_t >();
+	}
+
+	// 共享的模型只由第一个使用它的detector预热一次, 其余detector直接取得预热结果
+	long_batch.split_output = registry.warm_up(long_model_key, *p_long_backend, *p_detector_param).split_output;
+	aggr_batch.split_output = registry.warm_up(aggr_model_key, *p_aggr_backend, *p_detector_param).split_output;
+
+}
+
+void DetectorWorkerThread::prepare_buffers() {
+
+	const torch::Dtype dtype = precision_dtype(p_detector_param->precision);
+
+	aggr_scale_ = aggr_scale_.to(dtype).contiguous();
+	aggr_min_ = aggr_min_.to(dtype).contiguous();
+	long_scale_ = long_scale_.to(dtype).contiguous();
+	long_min_ = long_min_.to(dtype).contiguous();
+
+	const uint32_t slice_len = p_detector_param->slice_len;
+	const uint32_t trunc_flow_len = max(p_detector_param->trunc_flow_len, slice_len);
+
+	// 批在slice数达到max_batch_size时提交, 因此最多再容纳一条最长序列的slices
+	const int64_t max_flow_slice_num = (trunc_flow_len - slice_len) / p_detector_param->stride + 1;
+	const int64_t capacity = p_detector_param->max_batch_size + max_flow_slice_num - 1;
+
+	long_batch.input_buf = torch::empty({capacity, slice_len, 3}, torch::TensorOptions().dtype(dtype));
+	aggr_batch.input_buf = torch::empty({capacity, slice_len, 3}, torch::TensorOptions().dtype(dtype));
+
+	row_buf = torch::empty({trunc_flow_len, 3}, torch::TensorOptions().dtype(dtype));
+
+}
+
+torch::Tensor DetectorWorkerThread::preprocess(const PktMetaDataArray & flat_vec, bool use_aggr_model) const {
+
+	const torch::Tensor & scale_ = use_aggr_model ? aggr_scale_ : long_scale_;
+	const torch::Tensor & min_ = use_aggr_model ? aggr_min_ : long_min_;
+
+	const int64_t _len = min(flat_vec.size() / 3, static_cast<size_t >(p_detector_param->trunc_flow_len));
+
+	// 按数值(而非按位)解释uint64特征; 包间隔在整数域计算, 避免ns时间戳转为浮点后的精度损失
+	torch::Tensor raw = torch::from_blob(const_cast<uint64_t * >(flat_vec.data()), {_len, 3}, torch::kLong);
+
+	torch::Tensor latter = raw.index({torch::indexing::Slice(1), 0});
+    torch::Tensor former = raw.index({torch::indexing::Slice(0, -1), 0});
 
-				long_inference_inputs.clear();
+	torch::Tensor intervals = (latter - former).to(precision_dtype(p_detector_param->precision));
+
+	// to()产生副本, 之后的原地修改不会影响共享的序列缓冲
+	torch::Tensor _ten = raw.to(precision_dtype(p_detector_param->precision));
+
+	_ten.index_put_({torch::indexing::Slice(1), 0}, intervals);
+	_ten.index_put_({0, 0}, 0);	
+
+	torch::Tensor norm_ten = scale_ * _ten + min_;
+
+	return norm_ten.unfold(0, p_detector_param->slice_len, p_detector_param->stride).permute({0, 2, 1});
+
+}
 
+int64_t DetectorWorkerThread::preprocess_native(const PktMetaDataArray & flat_vec, bool use_aggr_model, torch::Tensor & out, int64_t offset) {
+
+	const torch::Tensor & scale_ = use_aggr_model ? aggr_scale_ : long_scale_;
+	const torch::Tensor & min_ = use_aggr_model ? aggr_min_ : long_min_;
+
+	const uint32_t _len = min(flat_vec.size() / 3, static_cast<size_t >(p_detector_param->trunc_flow_len));
+	const uint32_t slice_len = p_detector_param->slice_len;
+
+	if (p_detector_param->precision == InferencePrecision::FLOAT64) {
+		return fused_preprocess<double >(flat_vec.data(), _len, slice_len, p_detector_param->stride,
+										scale_.data_ptr<double >(), min_.data_ptr<double >(),
+										row_buf.data_ptr<double >(), out.data_ptr<double >() + offset * slice_len * 3);
+	} else {
+		return fused_preprocess<float >(flat_vec.data(), _len, slice_len, p_detector_param->stride,
+										scale_.data_ptr<float >(), min_.data_ptr<float >(),
+										row_buf.data_ptr<float >(), out.data_ptr<float >() + offset * slice_len * 3);
+	}
+
+}
+
+int64_t DetectorWorkerThread::preprocess_rows(const PktMetaDataArray & flat_vec, bool use_aggr_model, torch::Tensor & out, int64_t row_offset) {
+
+	const uint32_t _len = min(flat_vec.size() / 3, static_cast<size_t >(p_detector_param->trunc_flow_len));
+
+	return preprocess_rows(flat_vec.data(), 0, _len, use_aggr_model, out, row_offset);
+
+}
+
+int64_t DetectorWorkerThread::preprocess_rows(const uint64_t * flat, uint32_t begin, uint32_t end, bool use_aggr_model, torch::Tensor & out, int64_t row_offset) {
+
+	const torch::Tensor & scale_ = use_aggr_model ? aggr_scale_ : long_scale_;
+	const torch::Tensor & min_ = use_aggr_model ? aggr_min_ : long_min_;
+
+	if (begin >= end) return 0;
+
+	if (p_detector_param->precision == InferencePrecision::FLOAT64) {
+		fused_normalize<double >(flat, begin, end, scale_.data_ptr<double >(), min_.data_ptr<double >(), out.data_ptr<double >() + row_offset * 3);
+	} else {
+		fused_normalize<float >(flat, begin, end, scale_.data_ptr<float >(), min_.data_ptr<float >(), out.data_ptr<float >() + row_offset * 3);
+	}
+
+	return end - begin;
+
+}
+
+ModelProfile ModelRegistry::warm_up(const string & key, DetectorBackend & backend, const DetectorThreadParam & param) {
+
+	lock_guard<mutex> _lock(registry_lock);
+
+	const auto _iter = profile_map.find(key);
+	if (_iter != profile_map.end()) return _iter->second;
+
+	c10::InferenceMode inference_guard;
+
+	const uint32_t slice_len = param.slice_len;
+	const uint32_t trunc_flow_len = max(param.trunc_flow_len, slice_len);
+
+	// 与detector的批缓冲相同的两种形状: 单条最长序列的slices, 以及满批
+	const int64_t max_flow_slice_num = (trunc_flow_len - slice_len) / param.stride + 1;
+	const int64_t capacity = param.max_batch_size + max_flow_slice_num - 1;
+
+	const torch::Tensor input_buf = torch::zeros({capacity, slice_len, 3}, torch::TensorOptions().dtype(precision_dtype(param.precision)));
+
+	const uint32_t iters = max(param.warmup_iters, 1u);
+
+	ModelProfile profile;
+
+	double_t steady_time = 0;
+	uint32_t steady_num = 0;
+	bool first = true;
+
+	for (const int64_t _n : {max_flow_slice_num, static_cast<int64_t >(param.max_batch_size)}) {
+
+		for (uint32_t k = 0; k < iters; k ++) {
+
+			double_t start_ts = __get_double_ts();
+
+			if (param.streaming_inference) {
+				// 行数不超过_n个slices所占的元素
+				const vector<int64_t > row_num_vec(max<int64_t >(_n * slice_len / trunc_flow_len, 1), trunc_flow_len);
+				backend.forward_stream(input_buf.view({-1, 3}), row_num_vec, slice_len, param.stride, {});
+			} else {
+				const torch::Tensor out = backend.forward(input_buf.narrow(0, 0, _n));
+				// 输出不随slice数变化(如返回一个标量)时, 一个批的结果无法还原到其中的各条序列
+				if (!(out.defined() && out.dim() > 0 && out.size(0) == _n)) profile.split_output = false;
+			}
+
+			double_t end_ts = __get_double_ts();
+
+			if (first) {
+				profile.cold_start_latency = end_ts - start_ts;
+				first = false;
 			}
 
+			if (k >= iters / 2) {
+				steady_time += end_ts - start_ts;
+				steady_num ++;
+			}
 
 		}
 
 	}
 
-	return true;
+	profile.steady_state_latency = steady_num ? steady_time / steady_num : 0;
+
+	LOGF("Model %s Warmed Up (Cold Start %4.4lf ms, Steady State %4.4lf ms).", key.c_str(), profile.cold_start_latency * 1e3, profile.steady_state_latency * 1e3);
+
+	if (!profile.split_output) WARNF("Output of Model %s Cannot be Split per Slice, Detectors Run One Flow per Forward on It.", key.c_str());
+
+	profile_map.emplace(key, profile);
+
+	return profile;
+
+}
+
+void ModelRegistry::display_profiles() {
+
+	lock_guard<mutex> _lock(registry_lock);
+
+	for (const auto & _item : profile_map) {
+
+		LOGF("Model %s Inference Latency: [Cold Start %4.4lf ms, Steady State %4.4lf ms]", 
+				_item.first.c_str(), _item.second.cold_start_latency * 1e3, _item.second.steady_state_latency * 1e3);
+
+	}
+
+}
+
+void Reaper::prefilter_features(const PktMetaDataArray & flat_vec, const uint32_t len, double_t * features) {
+
+	uint32_t size_hist[16] = {0};
+	uint32_t type_cnt[3] = {0};
+
+	double_t iat_sum = 0, iat_sq_sum = 0, size_sum = 0;
+
+	for (uint32_t i = 0; i < len; i ++) {
+
+		const uint64_t * p = flat_vec.data() + 3 * i;
+
+		if (i > 0) {
+			const double_t iat = static_cast<double_t >(static_cast<int64_t >(p[0] - p[-3]));
+			iat_sum += iat;
+			iat_sq_sum += iat * iat;
+		}
+
+		size_sum += p[1];
+		size_hist[min(p[1] / 100, static_cast<uint64_t >(15))] ++;
+		if (p[2] < 3) type_cnt[p[2]] ++;
+
+	}
+
+	const double_t iat_num = max(len - 1, 1u);
+	const double_t iat_mean = iat_sum / iat_num;
+	const double_t iat_var = max(iat_sq_sum / iat_num - iat_mean * iat_mean, 0.0);
+
+	double_t size_entropy = 0;
+	for (const auto _c : size_hist) {
+		if (_c == 0) continue;
+		const double_t _p = static_cast<double_t >(_c) / len;
+		size_entropy -= _p * log2(_p);
+	}
+
+	features[0] = log1p(max(iat_mean, 0.0));
+	features[1] = iat_mean > 0 ? sqrt(iat_var) / iat_mean : 0.0;
+	features[2] = size_entropy / 4.0;
+	features[3] = size_sum / len / 1500.0;
+	for (size_t k = 0; k < 3; k ++) features[4 + k] = static_cast<double_t >(type_cnt[k]) / len;
+
+}
+
+bool DetectorWorkerThread::prefilter_escalate(const PktMetaDataArrayOutput & mts) {
+
+	double_t prefilter_start_ts = __get_double_ts();
+
+	const uint32_t _len = min(mts.p_flat_vec->size() / 3, static_cast<size_t >(p_detector_param->trunc_flow_len));
+
+	double_t features[PREFILTER_FEATURE_NUM];
+	prefilter_features(*mts.p_flat_vec, _len, features);
+
+	double_t logit = p_detector_param->prefilter_bias;
+	for (size_t k = 0; k < PREFILTER_FEATURE_NUM; k ++) logit += p_detector_param->prefilter_weights[k] * features[k];
+
+	const double_t score = 1.0 / (1.0 + exp(-logit));
+
+	bool escalate = false;
+
+	if (score < p_detector_param->prefilter_low_th) prefilter_benign_num ++;
+	else if (score > p_detector_param->prefilter_high_th) {
+		prefilter_alarm_num ++;
+		if (p_verdict_ring) {
+			Verdict _v = make_verdict(mts, _len, VerdictSource::PREFILTER);
+			_v.score = score;
+			p_verdict_ring->try_push(_v);
+		}
+	} else {
+		prefilter_escalate_num ++;
+		escalate = true;
+	}
+
+	prefilter_active_time += (__get_double_ts() - prefilter_start_ts);
+
+	return escalate;
+
+}
+
+Verdict DetectorWorkerThread::make_verdict(const PktMetaDataArrayOutput & mts, uint32_t len, VerdictSource source) const {
+
+	Verdict _v;
+
+	_v.key = mts.key;
+	_v.pkt_num = len;
+	_v.model = static_cast<uint8_t >(source);
+
+	if (len) {
+		_v.first_ts = (*mts.p_flat_vec)[0];
+		_v.last_ts = (*mts.p_flat_vec)[3 * (len - 1)];
+	}
+
+	_v.detect_ts = static_cast<uint64_t >(get_time_spec() * 1e9);
+
+	return _v;
+
+}
+
+size_t DetectorWorkerThread::schedule_by_deadline() {
+
+	const double_t relative_deadline[2] = {
+		p_detector_param->latency_slo / p_detector_param->sched_weights[0], 
+		p_detector_param->latency_slo / p_detector_param->sched_weights[1]
+	};
+
+	// 已处理完的来源整批补充: 按平均slice数估计凑满当前批所需的序列数 (流式分段按long批估计)
+	for (size_t c = 0; c < WORK_SOURCE_NUM; c ++) {
+
+		if (p_work_queue[c] == nullptr || pending_pos[c] < pending_mts[c].size()) continue;
+
+		pending_mts[c].clear();
+		pending_pos[c] = 0;
+
+		const InferenceBatch & batch = (c == static_cast<uint8_t >(DetectorModel::AGGR_MODEL)) ? aggr_batch : long_batch;
+		const double_t free_slices = max<double_t >(static_cast<double_t >(p_detector_param->max_batch_size) - batch.slice_num, 1.0);
+
+		const size_t want = min(static_cast<size_t >(ceil(free_slices / max(avg_mts_slices[c], 1.0))), static_cast<size_t >(p_detector_param->max_batch_size));
+
+		p_work_queue[c]->try_pop_bulk(pending_mts[c], want);
+
+	}
+
+	// 工作队列按入队顺序出队, 同一来源内截止时间近似非递减, 因此只比较各来源第一条待处理序列
+	// 每次调用只处理截止时间最早的来源的一批; 其他来源的序列继续等待, 与之后取出的批再比较, 
+	// 因此过载时处理能力按截止时间(即按权重)在类别之间分配; 流式分段的截止时间同样取决于其模型
+	size_t earliest = WORK_SOURCE_NUM;
+	double_t earliest_deadline = 0;
+
+	for (size_t c = 0; c < WORK_SOURCE_NUM; c ++) {
+
+		if (pending_pos[c] == pending_mts[c].size()) continue;
+
+		const PktMetaDataArrayOutput & _front = *pending_mts[c][pending_pos[c]];
+		const double_t _deadline = _front.enqueue_ts + relative_deadline[static_cast<uint8_t >(_front.model)];
+
+		if (earliest == WORK_SOURCE_NUM || _deadline < earliest_deadline) {
+			earliest = c;
+			earliest_deadline = _deadline;
+		}
+
+	}
+
+	if (earliest == WORK_SOURCE_NUM) return 0;
+
+	vector<shared_ptr<PktMetaDataArrayOutput > > & pending = pending_mts[earliest];
+
+	const double_t curr_ts = get_time_spec();
+
+	size_t processed = 0;
+
+	for (; pending_pos[earliest] < pending.size(); pending_pos[earliest] ++) {
+
+		const shared_ptr<PktMetaDataArrayOutput > p_mts = move(pending[pending_pos[earliest]]);
+
+		const uint8_t _class = static_cast<uint8_t >(p_mts->model);
+		const double_t queue_delay = max(curr_ts - p_mts->enqueue_ts, 0.0);
+
+		queue_delay_hist[_class].add_seconds(queue_delay);
+		class_mts_num[_class] ++;
+		class_queue_delay[_class] += queue_delay;
+		if (queue_delay > relative_deadline[_class]) deadline_miss_num[_class] ++;
+
+		detect_mts(p_mts);
+
+		processed ++;
+
+	}
+
+	return processed;
+
+}
+
+RNNStreamState * DetectorWorkerThread::resume_stream(const PktMetaDataArrayOutput & mts, uint32_t & begin, uint32_t & vol) {
+
+	auto _iter = stream_state_map.find(mts.key);
+
+	// 同一条流在一个批中只出现一次, 它的状态在批提交后才推进
+	if (_iter != stream_state_map.end() && _iter->second.in_batch) {
+
+		if (_iter->second.model == DetectorModel::AGGR_MODEL) flush_batch(aggr_batch, *p_aggr_backend);
+		else flush_batch(long_batch, *p_long_backend);
+
+	}
+
+	StreamFlowState & _flow = stream_state_map[mts.key];
+
+	// 分类随流的统计变化而改用另一个模型时, 状态不再适用, 从第一个包重新开始
+	if (_flow.model != mts.model) {
+		_flow.state = RNNStreamState();
+		_flow.model = mts.model;
+	}
+
+	_flow.last_ts = get_time_spec();
+	_flow.ended = _flow.ended || mts.stream_end;
+
+	// 各段共享流的缓冲区, 每段覆盖此前的所有包: 被丢弃的段由下一段补上, 已被覆盖的段直接跳过
+	const uint32_t _len = min(mts.stream_len, p_detector_param->trunc_flow_len);
+
+	begin = static_cast<uint32_t >(min<uint64_t >(_flow.state.steps, _len));
+	vol = mts.vol > _flow.vol ? mts.vol - _flow.vol : 0;
+	_flow.vol = max(_flow.vol, mts.vol);
+
+	stream_chunk_num ++;
+
+	if (begin == _len) {
+
+		if (_flow.ended) stream_state_map.erase(mts.key);
+
+		return nullptr;
+
+	}
+
+	return &_flow.state;
+
+}
+
+void DetectorWorkerThread::expire_stream_states() {
+
+	const double_t curr_ts = get_time_spec();
+
+	for (auto _iter = stream_state_map.begin(); _iter != stream_state_map.end(); ) {
+
+		if (!_iter->second.in_batch && curr_ts - _iter->second.last_ts > p_detector_param->stream_state_timeout) {
+
+			_iter = stream_state_map.erase(_iter);
+			stream_expired_num ++;
+
+		} else {
+
+			_iter ++;
+
+		}
+
+	}
+
+}
+
+void DetectorWorkerThread::detect_mts(const shared_ptr<PktMetaDataArrayOutput > & p_mts) {
+
+	// 分段到达的流从其推断状态续接, 只处理之前的分段之后新到达的包 (vol为新增的流量);
+	// 不足一个slice的分段同样推进状态, 只是没有结束的窗口
+	RNNStreamState * p_state = nullptr;
+	uint32_t stream_begin = 0, vol = p_mts->vol;
+
+	if (p_mts->stream_len) {
+
+		p_state = resume_stream(*p_mts, stream_begin, vol);
+
+		if (p_state == nullptr) return;
+
+	} else if (p_mts->p_flat_vec->size() < 3 * p_detector_param->slice_len) {
+
+		// 分类表可能将不足一个slice的序列送往任意模型, 这些序列不做推断
+		sum_inference_pkt_len += p_mts->vol;
+		sum_pre_pkt_len += p_mts->vol;
+
+		return;
+
+	}
+
+	sum_detect_pkt_len += vol;
+
+	// 只有预过滤无法判定的序列进入RNN模型; 分段的流已按分类表作为长流评分, 不经过预过滤
+	if (p_state == nullptr && p_detector_param->prefilter && !prefilter_escalate(*p_mts)) return;
+
+	const bool use_aggr_model = (p_mts->model == DetectorModel::AGGR_MODEL);
+
+	DetectorBackend & backend = use_aggr_model ? *p_aggr_backend : *p_long_backend;
+	InferenceBatch & batch = use_aggr_model ? aggr_batch : long_batch;
+
+	// 分段的包数在assembler写入时确定, 之后追加的包不可读
+	const uint32_t _len = p_state ? min(p_mts->stream_len, p_detector_param->trunc_flow_len) : 
+									min(p_mts->p_flat_vec->size() / 3, static_cast<size_t >(p_detector_param->trunc_flow_len));
+
+	double_t pre_start_ts = __get_double_ts();
+
+	int64_t slice_num, row_num = 0;
+
+	if (p_detector_param->streaming_inference) {
+
+		// 窗口数与unfold得到的slice数一致; 分段只输出其新增行中结束的窗口
+		row_num = preprocess_rows(p_mts->p_flat_vec->data(), stream_begin, _len, use_aggr_model, batch.input_buf, batch.row_num);
+		slice_num = NativeRNNModel::window_num(stream_begin + row_num, p_detector_param->slice_len, p_detector_param->stride) - 
+					NativeRNNModel::window_num(stream_begin, p_detector_param->slice_len, p_detector_param->stride);
+
+	} else if (p_detector_param->native_preprocess) {
+
+		slice_num = preprocess_native(*p_mts->p_flat_vec, use_aggr_model, batch.input_buf, batch.slice_num);
+
+	} else {
+
+		torch::Tensor slices = preprocess(*p_mts->p_flat_vec, use_aggr_model);
+		slice_num = slices.size(0);
+		batch.input_buf.narrow(0, batch.slice_num, slice_num).copy_(slices);
+
+	}
+
+	double_t pre_end_ts = __get_double_ts();
+
+	sum_pre_pkt_len += vol;
+	pre_active_time += (pre_end_ts - pre_start_ts); 
+	interval_latency_hist[static_cast<uint8_t >(LatencyStage::PREPROCESS)].add_seconds(pre_end_ts - pre_start_ts);
+
+	if (batch.empty()) batch.open_ts = pre_end_ts;
+
+	const size_t _source = p_state ? STREAM_SOURCE : static_cast<uint8_t >(p_mts->model);
+	avg_mts_slices[_source] = 0.9 * avg_mts_slices[_source] + 0.1 * slice_num;
+
+	batch.slice_num_vec.push_back(slice_num);
+	batch.row_num_vec.push_back(row_num);
+	batch.state_vec.push_back(p_state);
+	batch.vol_vec.push_back(vol);
+	batch.slice_num += slice_num;
+	batch.row_num += row_num;
+	batch.vol += vol;
+
+	if (p_state) {
+		batch.stream_key_vec.push_back(p_mts->key);
+		stream_state_map[p_mts->key].in_batch = true;
+	}
+
+	// 分段的结论覆盖流此时已到达的包
+	if (p_verdict_ring) batch.verdict_vec.push_back(make_verdict(*p_mts, _len, use_aggr_model ? VerdictSource::AGGR_MODEL : VerdictSource::LONG_MODEL));
+
+	// 分段的行数不受其窗口数约束, 流式推断时另外保证行缓冲还能容纳一条最长序列
+	const bool rows_full = p_detector_param->streaming_inference && 
+							batch.row_num + max(p_detector_param->trunc_flow_len, p_detector_param->slice_len) > batch.input_buf.size(0) * p_detector_param->slice_len;
+
+	if (batch.slice_num >= p_detector_param->max_batch_size || !batch.split_output || rows_full) flush_batch(batch, backend);
+
+}
+
+void DetectorWorkerThread::flush_batch(InferenceBatch & batch, DetectorBackend & backend) {
+
+	double_t inference_start_ts = __get_double_ts();
+	torch::Tensor out;
+
+	if (p_detector_param->streaming_inference) {
+		out = backend.forward_stream(batch.input_buf.view({-1, 3}).narrow(0, 0, batch.row_num), batch.row_num_vec, p_detector_param->slice_len, p_detector_param->stride, batch.state_vec);
+	} else {
+		out = backend.forward(batch.input_buf.narrow(0, 0, batch.slice_num));
+	}
+	double_t inference_end_ts = __get_double_ts();
+
+	sum_inference_pkt_len += batch.vol;
+	inference_active_time += (inference_end_ts - inference_start_ts); 
+	interval_latency_hist[static_cast<uint8_t >(LatencyStage::INFERENCE)].add_seconds(inference_end_ts - inference_start_ts);
+
+	batch_size_hist.add(batch.slice_num);
+
+	// 输出首维与批内slice数一致时按序列拆分, 否则(模型已做规约)无法还原到单条序列
+	if (out.defined() && out.dim() > 0 && out.size(0) == batch.slice_num) {
+
+		// 每条序列的得分: 各窗口输出均值的最大值; 推送失败(ring已满)只计数, detector从不等待
+		if (p_verdict_ring && batch.verdict_vec.size() == batch.slice_num_vec.size()) {
+
+			const torch::Tensor window_scores = out.to(torch::kFloat64).reshape({batch.slice_num, -1}).mean(1).contiguous();
+			const double_t * p_score = window_scores.data_ptr<double_t >();
+			const uint64_t detect_ts = static_cast<uint64_t >(get_time_spec() * 1e9);
+
+			for (size_t i = 0; i < batch.verdict_vec.size(); i ++) {
+
+				Verdict & _v = batch.verdict_vec[i];
+				const int64_t _n = batch.slice_num_vec[i];
+
+				// 没有新结束窗口的分段不产生结论
+				if (_n == 0) continue;
+
+				_v.score = *max_element(p_score, p_score + _n);
+				_v.detect_ts = detect_ts;
+				p_score += _n;
+
+				p_verdict_ring->try_push(_v);
+
+			}
+
+		}
+
+	} else if (p_verdict_ring) {
+
+		// 启动时已拒绝这类模型, 运行中输出形状与预热不一致时这些批不产生结论
+		if (unsplit_batch_num ++ == 0) WARNF("Output of a Batch on Core #%d Cannot be Split per Slice, No Verdicts are Written for It.", m_core_id);
+
+	}
+
+	// double kl_loss_i = out.item<double_t >();
+
+	// 各分段的状态已推进, 释放已结束的流
+	for (const MTSKey & _key : batch.stream_key_vec) {
+
+		auto _iter = stream_state_map.find(_key);
+
+		if (_iter == stream_state_map.end()) continue;
+
+		_iter->second.in_batch = false;
+
+		if (_iter->second.ended) stream_state_map.erase(_iter);
+
+	}
+
+	batch.clear();
 
 }
 
@@ -205,6 +875,36 @@ pair<double_t, double_t > DetectorWorkerThread::get_overall_performance() const
 
 }
 
+pair<double_t, double_t > DetectorWorkerThread::get_cascade_performance() const {
+
+	const uint64_t filtered_num = prefilter_benign_num + prefilter_alarm_num + prefilter_escalate_num;
+	const double_t escalation_rate = filtered_num ? static_cast<double_t >(prefilter_escalate_num) / filtered_num : 1.0;
+
+	const double_t active_time = prefilter_active_time + pre_active_time + inference_active_time;
+	const double_t effective_throughput = active_time > 0 ? (((double_t) sum_detect_pkt_len) * 8.0) / active_time / 1e9 : 0.0;
+
+	return {escalation_rate, effective_throughput};
+
+}
+
+pair<double_t, double_t > DetectorWorkerThread::get_queueing_performance(DetectorModel model) const {
+
+	const uint8_t _class = static_cast<uint8_t >(model);
+
+	if (class_mts_num[_class] == 0) return {0.0, 0.0};
+
+	return {class_queue_delay[_class] / class_mts_num[_class], static_cast<double_t >(deadline_miss_num[_class]) / class_mts_num[_class]};
+
+}
+
+const LatencyHistogram & DetectorWorkerThread::get_latency_histogram(LatencyStage stage) const {
+
+	if (!m_stop) WARN("Detecting is Not Finished.");
+
+	return latency_hist[static_cast<uint8_t >(stage)];
+
+}
+
 void DetectorWorkerThread::load_params_via_json(const json &jin) {
 
 	if (p_detector_param != nullptr) {
@@ -252,11 +952,108 @@ void DetectorWorkerThread::load_params_via_json(const json &jin) {
 		}
 
 
+		if (jin.count("max_batch_size")) {
+			p_detector_param->max_batch_size = static_cast<decltype(p_detector_param->max_batch_size)>(jin["max_batch_size"]);
+		}
+
+		if (jin.count("batch_timeout")) {
+			p_detector_param->batch_timeout = static_cast<decltype(p_detector_param->batch_timeout)>(jin["batch_timeout"]);
+		}
+
+		if (jin.count("latency_slo")) {
+			p_detector_param->latency_slo = static_cast<decltype(p_detector_param->latency_slo)>(jin["latency_slo"]);
+		}
+
+		if (jin.count("sched_weights")) {
+			const json & j_weights = jin["sched_weights"];
+			if (j_weights.count("long")) p_detector_param->sched_weights[0] = static_cast<double_t >(j_weights["long"]);
+			if (j_weights.count("aggr")) p_detector_param->sched_weights[1] = static_cast<double_t >(j_weights["aggr"]);
+			if (p_detector_param->sched_weights[0] <= 0 || p_detector_param->sched_weights[1] <= 0) FATAL_ERROR("Parameter(sched_weights) Must be Positive!");
+		}
+
+		if (jin.count("intra_op_threads")) {
+			p_detector_param->intra_op_threads = max(1u, static_cast<uint32_t >(jin["intra_op_threads"]));
+		}
+
+		if (jin.count("inter_op_threads")) {
+			p_detector_param->inter_op_threads = max(1u, static_cast<uint32_t >(jin["inter_op_threads"]));
+		}
+
+		if (jin.count("torch_cores")) {
+			const vector<int> & core_vec = jin["torch_cores"];
+			p_detector_param->torch_cores.assign(core_vec.cbegin(), core_vec.cend());
+		}
+
+		if (jin.count("native_preprocess")) {
+			p_detector_param->native_preprocess = jin["native_preprocess"];
+		}
+
+		if (jin.count("streaming_inference")) {
+			p_detector_param->streaming_inference = jin["streaming_inference"];
+		}
+
+		if (jin.count("stream_queue")) p_detector_param->stream_queue_param.load_params_via_json(jin["stream_queue"]);
+
+		if (jin.count("stream_state_timeout")) {
+			p_detector_param->stream_state_timeout = static_cast<decltype(p_detector_param->stream_state_timeout)>(jin["stream_state_timeout"]);
+		}
+
+		if (jin.count("verdict_sink")) {
+			p_detector_param->verdict_sink_param.load_params_via_json(jin["verdict_sink"]);
+		}
+
+		if (jin.count("prefilter")) {
+			p_detector_param->prefilter = jin["prefilter"];
+		}
+
+		if (jin.count("prefilter_weights")) {
+			const vector<double_t > & weight_vec = jin["prefilter_weights"];
+			if (weight_vec.size() != PREFILTER_FEATURE_NUM) FATAL_ERROR("Parameter(prefilter_weights) Must Have " + to_string(PREFILTER_FEATURE_NUM) + " Elements!");
+			p_detector_param->prefilter_weights = weight_vec;
+		}
+
+		if (jin.count("prefilter_bias")) {
+			p_detector_param->prefilter_bias = static_cast<decltype(p_detector_param->prefilter_bias)>(jin["prefilter_bias"]);
+		}
+
+		if (jin.count("prefilter_low_th")) {
+			p_detector_param->prefilter_low_th = static_cast<decltype(p_detector_param->prefilter_low_th)>(jin["prefilter_low_th"]);
+		}
+
+		if (jin.count("prefilter_high_th")) {
+			p_detector_param->prefilter_high_th = static_cast<decltype(p_detector_param->prefilter_high_th)>(jin["prefilter_high_th"]);
+		}
+
+		if (jin.count("backend")) {
+			const string _backend = jin["backend"];
+			if (_backend == "torchscript") p_detector_param->backend = DetectorBackendType::TORCHSCRIPT;
+			else if (_backend == "native") p_detector_param->backend = DetectorBackendType::NATIVE;
+			else FATAL_ERROR("Parameter(backend) is Incorrect! (torchscript or native)");
+		}
+
+		if (jin.count("freeze_model")) {
+			p_detector_param->freeze_model = jin["freeze_model"];
+		}
+
+		if (jin.count("warmup_iters")) {
+			p_detector_param->warmup_iters = static_cast<decltype(p_detector_param->warmup_iters)>(jin["warmup_iters"]);
+		}
+
+		if (jin.count("precision")) {
+			const string _precision = jin["precision"];
+			if (_precision == "float64") p_detector_param->precision = InferencePrecision::FLOAT64;
+			else if (_precision == "float32") p_detector_param->precision = InferencePrecision::FLOAT32;
+			else if (_precision == "int8") p_detector_param->precision = InferencePrecision::INT8;
+			else FATAL_ERROR("Parameter(precision) is Incorrect! (float64, float32 or int8)");
+		}
+
 		if (jin.count("model")) {
 			p_detector_param->model = static_cast<decltype(p_detector_param->model)>(jin["model"]);
 
-				p_detector_param->aggr_model_path = "../models4latency/" + p_detector_param->model + ".pt";
-				p_detector_param->long_model_path = "../models4latency/" + p_detector_param->model + ".pt";
+				const string _suffix = p_detector_param->precision == InferencePrecision::INT8 ? "_int8.pt" : ".pt";
+
+				p_detector_param->aggr_model_path = "../models4latency/" + p_detector_param->model + _suffix;
+				p_detector_param->long_model_path = "../models4latency/" + p_detector_param->model + _suffix;
 
 			// if (p_detector_param->model == "1001") {
 
@@ -2,7 +2,11 @@
 
 #include <torch/torch.h>
 #include <torch/script.h>
+#include <cstring>
+#include <mutex>
 // #include "dpdkAppUtility.hpp"
+#include "detectorBackend.hpp"
+#include "verdictSink.hpp"
 #include "inspectorWorker.hpp"
 #include "aggregatorWorker.hpp"
 
@@ -13,6 +17,32 @@ class ConfigReaper;
 class InspectorWorkerThread;
 class AggregatorWorkerThread;
 
+// 推断精度: FLOAT32直接以float32构造输入并把模型转为float32; 
+// INT8加载离线动态量化(Linear/RNN层)的TorchScript模型<model>_int8.pt, 其输入为float32
+enum class InferencePrecision { FLOAT64, FLOAT32, INT8 };
+
+inline torch::Dtype precision_dtype(InferencePrecision p) {
+    return p == InferencePrecision::FLOAT64 ? torch::kFloat64 : torch::kFloat32;
+}
+
+// 预过滤的统计特征: log平均包间隔, 包间隔变异系数, 包长熵(16桶, 归一化), 平均包长/1500, type为0/1/2的比例
+const size_t PREFILTER_FEATURE_NUM = 7;
+
+// 单次遍历计算len个数据包的预过滤特征
+void prefilter_features(const PktMetaDataArray & flat_vec, const uint32_t len, double_t * features);
+
+// 推断后端: libtorch执行TorchScript模块, 或原生GRU/LSTM实现(float32, 权重取自同一TorchScript模型)
+enum class DetectorBackendType { TORCHSCRIPT, NATIVE };
+
+inline const char * precision_name(InferencePrecision p) {
+    switch (p) {
+        case InferencePrecision::FLOAT64: return "float64";
+        case InferencePrecision::FLOAT32: return "float32";
+        case InferencePrecision::INT8: return "int8";
+    }
+    return "unknown";
+}
+
 
 struct DetectorThreadParam final {
 
@@ -25,11 +55,54 @@ struct DetectorThreadParam final {
     uint32_t slice_len = 40;
     uint32_t stride = slice_len >> 2;
 
+    // Dynamic Batching: 按slice数凑批, 或最早入批的序列等待超过batch_timeout(秒)时提交
+    uint32_t max_batch_size = 128;
+    double_t batch_timeout = 0.002;
+
+    // 按最早截止时间(EDF)调度各队列的序列: 截止时间 = 入队时间 + latency_slo / 类别权重
+    // 权重按DetectorModel索引 (long, aggr), 权重越大的类别截止时间越紧, 排队延迟超过截止时间计为一次违约
+    double_t latency_slo = 0.05;
+    double_t sched_weights[2] = {1.0, 1.0};
+
+    // 使用融合的native预处理kernel (否则使用libtorch算子链)
+    bool native_preprocess = true;
+
+    // 有状态的流式推断: 每条序列只经过RNN一次, 在步长边界输出各窗口的结果, 而不是对重叠的slices逐个推断
+    // 仅原生后端支持; 窗口的输出包含窗口之前的历史, 与逐slice推断的结果近似而不完全一致
+    bool streaming_inference = false;
+
+    // 增量评分(Assembler.stream_chunk_len): 长流的各段写入负责该流的detector私有的stream_queue, 每段从该流的推断状态续接
+    // 超过stream_state_timeout(秒)没有新分段的流(最后一段被丢弃, 或最终没有作为长流结束)释放其状态
+    // assembler在持有流表bucket写锁时写入stream_queue, 不能使用block策略
+    BoundedQueueParam stream_queue_param = BoundedQueueParam(1 << 14, OverloadPolicy::SHED_NEWEST);
+    double_t stream_state_timeout = 60.0;
+
+    // libtorch线程: 每个detector的intra-op线程数(含detector线程自身), 进程级inter-op线程池大小
+    // intra-op的额外线程绑定到torch_cores(不得与DPDK lcores重叠), 为空时与detector共享其lcore
+    uint32_t intra_op_threads = 1;
+    uint32_t inter_op_threads = 1;
+    vector<cpu_core_id_t > torch_cores;
+
+    // Pre-Filter Cascade: score = sigmoid(w · features + b), 
+    // score < prefilter_low_th判为良性, score > prefilter_high_th直接告警, 其余升级到RNN模型
+    bool prefilter = false;
+    vector<double_t > prefilter_weights = vector<double_t >(PREFILTER_FEATURE_NUM, 0.0);
+    double_t prefilter_bias = 0.0;
+    double_t prefilter_low_th = 0.2;
+    double_t prefilter_high_th = 0.8;
+
     // Loading Model
+    InferencePrecision precision = InferencePrecision::FLOAT64;
+    DetectorBackendType backend = DetectorBackendType::TORCHSCRIPT;
+    bool freeze_model = true; // torch::jit::freeze + optimize_for_inference
+    uint32_t warmup_iters = 50; // 启动前每个模型、每种输入形状的预热次数
     string model = "1001";
     string aggr_model_path = "../models/1001_aggr.pt";
     string long_model_path = "../models/1001_long.pt";
 
+    // 检测结论的输出 (由ConfigReaper创建唯一的VerdictSink, 各detector只向其私有ring写入)
+    VerdictSinkParam verdict_sink_param;
+
     void inline display_params() const {
 
         printf("[ ***DetectorThreadParam*** ]\n");
@@ -42,16 +115,335 @@ struct DetectorThreadParam final {
         printf("Slice Length: %d.\n", slice_len);
         printf("Slice Stride: %d.\n", stride);
 
+        printf("Max Batch Size: %d Slices, Batch Timeout: %4.4lf s.\n", max_batch_size, batch_timeout);
+
+        printf("EDF Scheduling -> Latency SLO: %4.4lf s, Weights: [Long %4.2lf, Aggr %4.2lf].\n", latency_slo, sched_weights[0], sched_weights[1]);
+
+        printf("Preprocessing: %s.\n", native_preprocess ? "Native Fused Kernel" : "LibTorch Op Chain");
+
+        printf("Streaming Inference: %s.\n", streaming_inference ? "On" : "Off");
+        if (streaming_inference) {
+            printf("Streaming State Timeout: %4.4lf s.\n", stream_state_timeout);
+            stream_queue_param.display_params("stream_queue");
+        }
+
+        if (prefilter) printf("Pre-Filter is Up, Benign below %4.4lf, Alarm above %4.4lf.\n", prefilter_low_th, prefilter_high_th);
+        else printf("Pre-Filter is Down.\n");
+
+        printf("Inference Precision: %s.\n", precision_name(precision));
+
+        printf("Inference Backend: %s.\n", backend == DetectorBackendType::NATIVE ? "Native RNN" : "TorchScript");
+
+        printf("Model Freezing: %s, Warm-Up Iterations: %d.\n", freeze_model ? "On" : "Off", warmup_iters);
+
+        printf("LibTorch Threads: %d Intra-Op per Detector, %d Inter-Op.\n", intra_op_threads, inter_op_threads);
+        if (torch_cores.empty()) printf("Intra-Op Threads are Pinned to Detector Cores.\n");
+        else {
+            printf("Intra-Op Threads are Pinned to Cores:");
+            for (const auto & _core : torch_cores) printf(" %d", _core);
+            printf(".\n");
+        }
+
         printf("Deployed Aggr Flow Model from: %s.\n", aggr_model_path.c_str());
         printf("Deployed Long Flow Model from: %s.\n", long_model_path.c_str());
 
+        verdict_sink_param.display_params();
+
     }
 
 };
 
+// 一个共享模型的预热结果
+struct ModelProfile final {
+
+    double_t cold_start_latency = 0;   // 首次forward的延迟(秒)
+    double_t steady_state_latency = 0; // 后一半迭代的平均延迟(秒)
+    bool split_output = true;          // 输出的首维与输入的slice一一对应, 批的结果可拆回各条序列
+
+};
+
+// TorchScript模型表: 每个(路径, 精度)只加载一次, 各detector共享同一模块及其权重
+// eval模式的模块forward可被多个线程并发调用
+class ModelRegistry final {
+
+private:
+
+    mutex registry_lock;
+    unordered_map<string, shared_ptr<torch::jit::script::Module > > model_map;
+    unordered_map<string, shared_ptr<const NativeRNNModel > > native_model_map;
+    unordered_map<string, ModelProfile > profile_map;
+
+public:
+
+    ModelRegistry() = default;
+    virtual ~ModelRegistry() {}
+    ModelRegistry & operator=(const ModelRegistry &) = delete;
+    ModelRegistry(const ModelRegistry &) = delete;
+
+    static inline string model_key(const string & path, InferencePrecision precision, bool freeze) {
+        return path + "@" + precision_name(precision) + (freeze ? "@frozen" : "");
+    }
+
+    static inline string native_model_key(const string & path) {
+        return path + "@native";
+    }
+
+    shared_ptr<torch::jit::script::Module > acquire(const string & path, InferencePrecision precision, bool freeze);
+
+    // 原生后端的模型, 由未冻结的TorchScript模块的参数构造
+    shared_ptr<const NativeRNNModel > acquire_native(const string & path);
+
+    // 用单条最长序列与满批两种形状的输入, 经backend预热key对应的模型, 并检查输出能否按slice拆分
+    // JIT的profiling与特化属于模块而非线程, 每个模型只在第一次调用时预热, 之后直接返回结果; 须在detectors启动之前调用
+    ModelProfile warm_up(const string & key, DetectorBackend & backend, const DetectorThreadParam & param);
+
+    // 输出所有模型的预热结果
+    void display_profiles();
+
+    size_t size() {
+        lock_guard<mutex> _lock(registry_lock);
+        return model_map.size() + native_model_map.size();
+    }
+
+};
+
+// 融合的预处理kernel的第一步: 读取原始的{ts, pkt_len, type}三元组, 在整数域计算包间隔(首包为0), 
+// 归一化(x * scale + min)后写入row_buf: [len, 3]
+// begin > 0时只归一化第begin至end个包(首行的包间隔取自第begin - 1个包), 写入row_buf: [end - begin, 3]
+template<typename T>
+inline void fused_normalize(const uint64_t * __restrict__ flat, const uint32_t begin, const uint32_t end, 
+                            const T * __restrict__ scale, const T * __restrict__ min, T * __restrict__ row_buf) {
+
+    if (begin >= end) return;
+
+    const T s0 = scale[0], s1 = scale[1], s2 = scale[2];
+    const T m0 = min[0], m1 = min[1], m2 = min[2];
+
+    uint32_t i = begin;
+
+    if (i == 0) {
+        row_buf[0] = m0;
+        row_buf[1] = s1 * static_cast<T >(flat[1]) + m1;
+        row_buf[2] = s2 * static_cast<T >(flat[2]) + m2;
+        i ++;
+    }
+
+    // 无跨行依赖, 可被编译器向量化
+    for (; i < end; i ++) {
+        const uint64_t * p = flat + 3 * i;
+        T * r = row_buf + 3 * (i - begin);
+        r[0] = s0 * static_cast<T >(static_cast<int64_t >(p[0] - p[-3])) + m0;
+        r[1] = s1 * static_cast<T >(p[1]) + m1;
+        r[2] = s2 * static_cast<T >(p[2]) + m2;
+    }
+
+}
+
+template<typename T>
+inline void fused_normalize(const uint64_t * __restrict__ flat, const uint32_t len, 
+                            const T * __restrict__ scale, const T * __restrict__ min, T * __restrict__ row_buf) {
+
+    fused_normalize<T >(flat, 0, len, scale, min, row_buf);
+
+}
+
+// 融合的预处理kernel: 归一化后将步长为stride的slices直接写入out: [slice_num, slice_len, 3]
+// row_buf至少容纳len * 3个元素, 返回写入的slice数
+template<typename T>
+inline int64_t fused_preprocess(const uint64_t * __restrict__ flat, const uint32_t len, 
+                                const uint32_t slice_len, const uint32_t stride,
+                                const T * __restrict__ scale, const T * __restrict__ min,
+                                T * __restrict__ row_buf, T * __restrict__ out) {
+
+    if (len < slice_len) return 0;
+
+    fused_normalize<T >(flat, len, scale, min, row_buf);
+
+    // 重叠的窗口在行缓冲上是连续的, 直接整块拷贝
+    const int64_t slice_num = (len - slice_len) / stride + 1;
+    const size_t slice_elem_num = static_cast<size_t >(slice_len) * 3;
+
+    for (int64_t k = 0; k < slice_num; k ++) {
+        memcpy(out + k * slice_elem_num, row_buf + k * stride * 3, slice_elem_num * sizeof(T));
+    }
+
+    return slice_num;
+
+}
+
+// 一个模型上待提交的推断批: 多条序列的slices依次写入预分配的input_buf, 一次forward, 结果按slice_num_vec拆回各序列
+// 流式推断时input_buf被视为[capacity * slice_len, 3]的行缓冲, 各序列归一化后的行依次写入
+struct InferenceBatch final {
+
+    torch::Tensor input_buf; // [capacity, slice_len, 3], 由prepare_buffers分配
+    vector<int64_t > slice_num_vec;
+    vector<int64_t > row_num_vec; // 仅流式推断
+    vector<RNNStreamState * > state_vec; // 仅流式推断: 分段到达的序列续接的状态, 完整的序列为空指针
+    vector<MTSKey > stream_key_vec; // 本批中分段到达的流, 提交后释放其中已结束的流的状态
+    vector<uint64_t > vol_vec;
+    vector<Verdict > verdict_vec; // 仅输出结论时: 各序列的key, 时间范围与包数, 在flush时填入得分
+
+    int64_t slice_num = 0;
+    int64_t row_num = 0;
+    uint64_t vol = 0;
+    double_t open_ts = 0.0; // 第一条序列入批的时间
+
+    // 模型输出的首维与输入的slice一一对应, 由预热确定; 否则模型对整个输入做了规约, 每次forward只放一条序列
+    bool split_output = true;
+
+    inline bool empty() const {
+        return slice_num_vec.empty();
+    }
+
+    inline void clear() {
+        slice_num_vec.clear();
+        row_num_vec.clear();
+        state_vec.clear();
+        stream_key_vec.clear();
+        vol_vec.clear();
+        verdict_vec.clear();
+        slice_num = 0;
+        row_num = 0;
+        vol = 0;
+    }
+
+};
+
+// log2分桶的直方图, 用于tracing模式下的batch size与batch latency
+struct Log2Histogram final {
+
+    static const size_t BUCKET_NUM = 24;
+
+    uint64_t buckets[BUCKET_NUM] = {0};
+
+    inline void add(uint64_t v) {
+        size_t b = 0;
+        while (v > 1 && b + 1 < BUCKET_NUM) {
+            v >>= 1;
+            b ++;
+        }
+        buckets[b] ++;
+    }
+
+    inline void reset() {
+        fill(buckets, buckets + BUCKET_NUM, 0);
+    }
+
+    // e.g. "[1,2):3 [8,16):10"
+    string to_string() const {
+        stringstream ss;
+        for (size_t b = 0; b < BUCKET_NUM; b ++) {
+            if (buckets[b] == 0) continue;
+            ss << "[" << (b == 0 ? 0 : (1ull << b)) << "," << (1ull << (b + 1)) << "):" << buckets[b] << " ";
+        }
+        return ss.str();
+    }
+
+};
+
+// 固定内存的log-linear(HDR)延迟直方图, 单位ns: 每个2的幂区间分为SUB_NUM个线性子桶, 相对误差不超过1/SUB_NUM
+// 不足SUB_NUM ns的值精确计数, 超过上限的值计入最后一个桶; 同构的直方图可直接按桶合并
+struct LatencyHistogram final {
+
+    static const uint32_t SUB_BITS = 5;
+    static const uint64_t SUB_NUM = 1ull << SUB_BITS;
+    static const uint32_t MAX_EXP = 40; // 约1100秒
+    static const size_t BUCKET_NUM = (MAX_EXP - SUB_BITS + 2) * SUB_NUM;
+
+    uint64_t buckets[BUCKET_NUM] = {0};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max_value = 0;
+
+    static inline size_t bucket_of(uint64_t v) {
+        if (v < SUB_NUM) return v;
+        const uint32_t e = 63 - __builtin_clzll(v);
+        if (e > MAX_EXP) return BUCKET_NUM - 1;
+        return (e - SUB_BITS + 1) * SUB_NUM + ((v >> (e - SUB_BITS)) - SUB_NUM);
+    }
+
+    // 桶的下界与宽度
+    static inline uint64_t bucket_low(size_t b) {
+        if (b < 2 * SUB_NUM) return b;
+        return (b % SUB_NUM + SUB_NUM) << (b / SUB_NUM - 1);
+    }
+
+    static inline uint64_t bucket_width(size_t b) {
+        return b < 2 * SUB_NUM ? 1 : (1ull << (b / SUB_NUM - 1));
+    }
+
+    inline void add(uint64_t v) {
+        buckets[bucket_of(v)] ++;
+        count ++;
+        sum += v;
+        if (v > max_value) max_value = v;
+    }
+
+    // 以秒为单位记录
+    inline void add_seconds(double_t t) {
+        add(t > 0 ? static_cast<uint64_t >(t * 1e9) : 0);
+    }
+
+    inline void merge(const LatencyHistogram & other) {
+        for (size_t b = 0; b < BUCKET_NUM; b ++) buckets[b] += other.buckets[b];
+        count += other.count;
+        sum += other.sum;
+        if (other.max_value > max_value) max_value = other.max_value;
+    }
+
+    inline void reset() {
+        fill(buckets, buckets + BUCKET_NUM, 0);
+        count = sum = max_value = 0;
+    }
+
+    // q in [0, 1], 返回所在桶的中点(不超过max_value), 单位ns
+    uint64_t percentile(double_t q) const {
+        if (count == 0) return 0;
+        const uint64_t rank = min(static_cast<uint64_t >(ceil(q * count)), count);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKET_NUM; b ++) {
+            seen += buckets[b];
+            if (seen >= rank && buckets[b]) return min(bucket_low(b) + (bucket_width(b) >> 1), max_value);
+        }
+        return max_value;
+    }
+
+    inline double_t mean() const {
+        return count ? static_cast<double_t >(sum) / count : 0.0;
+    }
+
+    // e.g. "n=120 mean=35.2 p50=33.0 p90=41.0 p99=60.5 p99.9=72.0 max=80.1 (us)"
+    string to_string() const {
+        char buf[192];
+        snprintf(buf, sizeof(buf), "n=%lu mean=%.1lf p50=%.1lf p90=%.1lf p99=%.1lf p99.9=%.1lf max=%.1lf (us)",
+                    count, mean() / 1e3, percentile(0.5) / 1e3, percentile(0.9) / 1e3,
+                    percentile(0.99) / 1e3, percentile(0.999) / 1e3, max_value / 1e3);
+        return string(buf);
+    }
+
+};
+
+// detector内部各阶段的延迟: 每条序列的预处理与排队, 每个批的推断
+enum class LatencyStage : uint8_t { PREPROCESS = 0, QUEUEING = 1, INFERENCE = 2 };
+
+const size_t LATENCY_STAGE_NUM = 3;
+
+inline const char * latency_stage_name(LatencyStage s) {
+    switch (s) {
+        case LatencyStage::PREPROCESS: return "Preprocess";
+        case LatencyStage::QUEUEING: return "Queueing";
+        case LatencyStage::INFERENCE: return "Inference";
+    }
+    return "Unknown";
+}
+
 class DetectorWorkerThread final : pcpp::DpdkWorkerThread {
 
     friend class ConfigReaper;
+    friend void validate_detector_precision(const json & j_detector_params);
+    friend void benchmark_detector_preprocess(const json & j_detector_params);
+    friend void benchmark_detector_backend(const json & j_detector_params);
+    friend void benchmark_detector_streaming(const json & j_detector_params);
 
 private:
 
@@ -61,8 +453,8 @@ private:
 
     shared_ptr<DetectorThreadParam > p_detector_param; // load_param_json 初始化
 
-    torch::jit::script::Module long_model; // run方法中初始化, 在while循环开始前
-    torch::jit::script::Module aggr_model; // run方法中初始化, 在while循环开始前
+    unique_ptr<DetectorBackend > p_long_backend; // 由ConfigReaper在启动前基于ModelRegistry中的模型创建
+    unique_ptr<DetectorBackend > p_aggr_backend; // 由ConfigReaper在启动前基于ModelRegistry中的模型创建
 
     // 1001 ******************************************************************************************************
     // aggr
@@ -73,18 +465,86 @@ private:
     torch::Tensor long_min_ = torch::tensor({2.93956917e-06, -1.02669405e-03, -5.46357276e-01}, torch::kFloat64);
     // ***********************************************************************************************************
 
-    vector<torch::jit::IValue > long_inference_inputs; // 临时变量
-    vector<torch::jit::IValue > aggr_inference_inputs; // 临时变量
+    InferenceBatch long_batch;
+    InferenceBatch aggr_batch;
+
+    // 两个模型在ModelRegistry中的键
+    string long_model_key;
+    string aggr_model_key;
+
+    // native kernel的行缓冲: [trunc_flow_len, 3]
+    torch::Tensor row_buf;
+
+    // 本detector的intra-op线程可用的核心, 由ConfigReaper按torch_cores分配
+    vector<cpu_core_id_t > torch_core_set;
+
+    // 当前report interval内的批大小(slices)分布
+    Log2Histogram batch_size_hist;
+
+    // 各阶段的延迟: 当前report interval内的分布, 以及每个interval结束(和detector停止)时并入的累计分布
+    LatencyHistogram interval_latency_hist[LATENCY_STAGE_NUM];
+    LatencyHistogram latency_hist[LATENCY_STAGE_NUM];
+
+    // 工作队列, 前两个由所有生产者与detectors共享, 由ConfigReaper在启动前连接, 按DetectorModel索引:
+    // long (inspectors与assemblers写入, 其中的序列可能按分类表使用aggr模型), aggr (aggregators写入);
+    // [STREAM_SOURCE]为本detector私有的流式分段队列, 由ConfigReaper在assembler开启分段时创建, 并连接到所有assemblers与inspectors
+    static const size_t STREAM_SOURCE = 2;
+    static const size_t WORK_SOURCE_NUM = 3;
+    shared_ptr<PktMetaDataArrayOutputQueue > p_work_queue[WORK_SOURCE_NUM];
+
+    // 调度: 从各工作队列整批取出, 尚未处理的序列, 以及每条序列的平均slice数(用于估计凑满一个批所需的序列数)
+    vector<shared_ptr<PktMetaDataArrayOutput > > pending_mts[WORK_SOURCE_NUM];
+    size_t pending_pos[WORK_SOURCE_NUM] = {0, 0, 0};
+    double_t avg_mts_slices[WORK_SOURCE_NUM] = {1.0, 1.0, 1.0};
+
+    // 分段到达的一条流: 推断状态, 使用的模型, 已处理的流量, 最近一段的到达时间, 是否在未提交的批中, 是否已结束
+    struct StreamFlowState {
+        RNNStreamState state;
+        DetectorModel model = DetectorModel::LONG_MODEL;
+        uint32_t vol = 0;
+        double_t last_ts = 0;
+        bool in_batch = false;
+        bool ended = false;
+    };
+
+    unordered_map<MTSKey, StreamFlowState, MTSKeyHash > stream_state_map;
+    uint64_t stream_chunk_num = 0;
+    uint64_t stream_expired_num = 0;
+
+    // 按类别(DetectorModel)统计的排队延迟: 当前report interval内的分布(interval结束时并入QUEUEING阶段), 累计的数量, 总延迟与截止时间违约数
+    LatencyHistogram queue_delay_hist[2];
+    uint64_t class_mts_num[2] = {0, 0};
+    double_t class_queue_delay[2] = {0, 0};
+    uint64_t deadline_miss_num[2] = {0, 0};
 
     // vector<double > kl_losses;  
 
-    uint32_t sum_inference_pkt_len = 0;
-    double_t inference_active_time;
+    uint64_t sum_inference_pkt_len = 0;
+    double_t inference_active_time = 0;
+
+    uint64_t sum_pre_pkt_len = 0;
+    double_t pre_active_time = 0;
+
+    // 预过滤: 判定结果计数与耗时
+    uint64_t prefilter_benign_num = 0;
+    uint64_t prefilter_alarm_num = 0;
+    uint64_t prefilter_escalate_num = 0;
+    double_t prefilter_active_time = 0;
+
+    // 进入detector的全部流量及其总处理时间(预过滤 + 预处理 + 推断), 用于计算等效吞吐
+    uint64_t sum_detect_pkt_len = 0;
+
+    // 预过滤一条序列, 返回是否需要升级到RNN模型
+    bool prefilter_escalate(const PktMetaDataArrayOutput & mts);
 
-    uint32_t sum_pre_pkt_len = 0;
-    double_t pre_active_time;
+    // 检测结论写入的ring, 由ConfigReaper在启动前连接, 为空时不输出结论
+    SPSCRing<Verdict > * p_verdict_ring = nullptr;
 
-    vector<double_t > inference_latency;
+    // 输出无法按slice拆分而没有产生结论的批数 (只在第一次出现时告警)
+    uint64_t unsplit_batch_num = 0;
+
+    // 由一条序列(截断后的前len个包)构造结论, 得分由调用者填入
+    Verdict make_verdict(const PktMetaDataArrayOutput & mts, uint32_t len, VerdictSource source) const;
 
     // shared_ptr<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > > p_short_aggr_queue;
     // shared_ptr<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > > p_long_queue;
@@ -93,6 +553,43 @@ private:
     vector<shared_ptr<InspectorWorkerThread > > p_inspector_vec;
     vector<shared_ptr<AggregatorWorkerThread > > p_aggregator_vec;
 
+    // 从模型表获取long/aggr模型(已转换到配置的精度并完成预热)并创建对应的推断后端
+    void load_models(ModelRegistry & registry);
+
+    // 设置本线程的intra-op线程数, 并在torch_core_set上创建intra-op线程池
+    void configure_torch_threads();
+
+    // 把归一化参数转换到配置的精度, 并分配批缓冲与行缓冲
+    void prepare_buffers();
+
+    // 截断, 计算包间隔, 归一化并切分为slices: [slice_num, slice_len, 3], dtype与precision一致 (libtorch算子链)
+    torch::Tensor preprocess(const PktMetaDataArray & flat_vec, bool use_aggr_model) const;
+
+    // 与preprocess相同的结果, 由fused_preprocess直接写入out[offset:], 返回slice数
+    int64_t preprocess_native(const PktMetaDataArray & flat_vec, bool use_aggr_model, torch::Tensor & out, int64_t offset);
+
+    // 流式推断的预处理: 只做截断与归一化, 把各行写入out(视为[*, 3])的第row_offset行起, 返回行数
+    int64_t preprocess_rows(const PktMetaDataArray & flat_vec, bool use_aggr_model, torch::Tensor & out, int64_t row_offset);
+
+    // 已处理完的类别整批取出约一个推断批的序列, 每次调用只处理队首截止时间最早的类别的一批, 返回处理数
+    size_t schedule_by_deadline();
+
+    // 流式推断的预处理: 只归一化第begin至end个包(begin之前的包已由之前的分段处理), 写入out的第row_offset行起, 返回行数
+    int64_t preprocess_rows(const uint64_t * flat, uint32_t begin, uint32_t end, bool use_aggr_model, torch::Tensor & out, int64_t row_offset);
+
+    // 分段到达的流: 返回续接的状态, 以及已处理的包数与新增的流量; 之前的分段已处理全部的包时返回空指针
+    // 同一条流的上一段仍在未提交的批中时, 先提交该批
+    RNNStreamState * resume_stream(const PktMetaDataArrayOutput & mts, uint32_t & begin, uint32_t & vol);
+
+    // 释放超时的流式推断状态
+    void expire_stream_states();
+
+    // 预处理一条序列(或一条流新到达的一段)并加入对应模型的批, 按序列携带的模型选择long/aggr模型与归一化参数
+    void detect_mts(const shared_ptr<PktMetaDataArrayOutput > & p_mts);
+
+    // 对一个批执行一次forward, 并把结果拆回各条序列
+    void flush_batch(InferenceBatch & batch, DetectorBackend & backend);
+
 
 public:
 
@@ -149,6 +646,15 @@ public:
 
     pair<double_t, double_t > get_overall_performance() const;
 
+    // 预过滤的升级比例, 以及计入预过滤后的等效吞吐(Gbps)
+    pair<double_t, double_t > get_cascade_performance() const;
+
+    // 一个类别的平均排队延迟(秒)与截止时间违约比例
+    pair<double_t, double_t > get_queueing_performance(DetectorModel model) const;
+
+    // 一个阶段的累计延迟分布, 须在detector停止之后读取
+    const LatencyHistogram & get_latency_histogram(LatencyStage stage) const;
+
 };
 
 }
\ No newline at end of file
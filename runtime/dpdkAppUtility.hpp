@@ -9,8 +9,15 @@
 #include <semaphore.h>
 
 #include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <netinet/in.h>
 
+#include <queue>
+#include <tuple>
+#include <array>
+#include <limits>
+
 #include <rte_malloc.h>
 
 #include <pcapplusplus/Packet.h>
@@ -34,6 +41,12 @@
 #include <tbb/parallel_for_each.h>
 #include <tbb/parallel_invoke.h>
 #include <tbb/concurrent_queue.h>
+#include <tbb/task_arena.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_scheduler_observer.h>
+#include <tbb/global_control.h>
 
 #include <bits/stdc++.h>
 
@@ -80,6 +93,113 @@ struct DpdkDevMap final {
 // Type: The list of DpdkDevConfigs -> All cores for parsing
 using dpdk_dev_map_list_t = vector<shared_ptr<DpdkDevMap > >;
 
+// 将task_arena中的TBB worker线程绑定到指定的cpu核心集合上, 避免与DPDK lcore争抢核心
+// 进入arena的master线程(即DPDK lcore自身)不做绑定
+class CorePinningObserver final : public tbb::task_scheduler_observer {
+
+    private:
+
+    cpu_set_t cpu_set;
+
+    public:
+
+    CorePinningObserver(tbb::task_arena & _arena, const vector<cpu_core_id_t > & _cores): tbb::task_scheduler_observer(_arena) {
+
+        CPU_ZERO(&cpu_set);
+        for (const auto & _core : _cores) CPU_SET(_core, &cpu_set);
+
+        observe(true);
+
+    }
+
+    virtual ~CorePinningObserver() { observe(false); }
+    CorePinningObserver & operator=(const CorePinningObserver &) = delete;
+    CorePinningObserver(const CorePinningObserver &) = delete;
+
+    virtual void on_scheduler_entry(bool is_worker) override {
+
+        if (!is_worker) return;
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0) {
+
+            WARN("Fail to Pin TBB Worker Thread to Specified Cores.");
+
+        }
+
+    }
+
+};
+
+// 将当前线程绑定到单个cpu核心
+static inline bool pin_current_thread(cpu_core_id_t core) {
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+
+}
+
+// 将调用线程绑定到一组核心上
+static inline bool pin_current_thread(const vector<cpu_core_id_t > & cores) {
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const auto & _core : cores) CPU_SET(_core, &cpu_set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+
+}
+
+// 基于eventfd的线程间唤醒通知, 等待期间的多次notify合并为一次唤醒
+// 先notify后wait不会丢失通知(计数保留在eventfd中)
+class EventNotifier final {
+
+    private:
+
+    int efd = -1;
+
+    public:
+
+    EventNotifier() {
+
+        efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (efd < 0) FATAL_ERROR("Fail to Create eventfd for Event Notifier.");
+
+    }
+
+    virtual ~EventNotifier() { if (efd >= 0) close(efd); }
+    EventNotifier & operator=(const EventNotifier &) = delete;
+    EventNotifier(const EventNotifier &) = delete;
+
+    void notify() {
+
+        const uint64_t _one = 1;
+        
+        if (write(efd, &_one, sizeof(_one)) != sizeof(_one)) WARN("Fail to Write eventfd of Event Notifier.");
+
+    }
+
+    // 阻塞直到收到通知或者超时(毫秒), 返回是否收到通知
+    bool wait(int timeout_ms) {
+
+        pollfd pfd;
+        pfd.fd = efd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+
+        uint64_t _cnt;
+
+        return read(efd, &_cnt, sizeof(_cnt)) == sizeof(_cnt);
+
+    }
+
+};
+
 struct PacketMetaData final {
 
 	uint32_t src_ip;
@@ -109,7 +229,61 @@ struct PacketMetaData final {
 };
 
 using PktMetaDataArray = vector<uint64_t >;
-using PktMetaDataArrayOutput = pair<shared_ptr<PktMetaDataArray >, uint32_t >;
+
+// detector中用于推断的模型
+enum class DetectorModel : uint8_t { LONG_MODEL = 0, AGGR_MODEL = 1 };
+
+// 检测对象的标识 (16字节): 长流为双向五元组(低/高IP及其端口, prefix_len为0), 聚合流为IP前缀(ip0/prefix_len), IP与端口均为主机字节序
+struct MTSKey {
+
+    uint32_t ip0 = 0, ip1 = 0;
+    uint16_t port0 = 0, port1 = 0;
+    uint8_t proto = 0;
+    uint8_t prefix_len = 0;
+    uint16_t reserved = 0;
+
+    MTSKey() {}
+    MTSKey(uint32_t _i0, uint32_t _i1, uint16_t _p0, uint16_t _p1, uint8_t _pr): ip0(_i0), ip1(_i1), port0(_p0), port1(_p1), proto(_pr) {}
+    MTSKey(uint32_t _prefix, uint8_t _len): ip0(_prefix), prefix_len(_len) {}
+
+    bool operator==(const MTSKey & k) const {
+        return ip0 == k.ip0 && ip1 == k.ip1 && port0 == k.port0 && port1 == k.port1 && proto == k.proto && prefix_len == k.prefix_len;
+    }
+
+};
+
+struct MTSKeyHash {
+
+    size_t operator()(const MTSKey & k) const {
+
+        const uint64_t h0 = (static_cast<uint64_t >(k.ip0) << 32) | k.ip1;
+        const uint64_t h1 = (static_cast<uint64_t >(k.port0) << 32) | (static_cast<uint64_t >(k.port1) << 16) | (static_cast<uint64_t >(k.proto) << 8) | k.prefix_len;
+
+        return std::hash<uint64_t >()(h0 * 0x9e3779b97f4a7c15ull ^ h1);
+
+    }
+
+};
+
+// 发送给detector的多维时间序列: 元数据数组, 流量大小, 推断所用的模型, 创建(入队)的时间, 以及检测对象的标识
+struct PktMetaDataArrayOutput {
+
+    shared_ptr<PktMetaDataArray > p_flat_vec;
+    uint32_t vol = 0;
+    DetectorModel model = DetectorModel::LONG_MODEL;
+    double_t enqueue_ts = 0; // get_time_spec(), 用于detector按截止时间调度并统计排队延迟
+    MTSKey key;
+
+    // 流式分段: 大于0时为一条仍在到达的长流的一段, p_flat_vec的前stream_len个包可读(缓冲区已预留, 不会重新分配),
+    // detector从该流的推断状态续接; stream_end表示流已结束(或缓冲区已写满), 处理后释放状态
+    uint32_t stream_len = 0;
+    bool stream_end = false;
+
+    PktMetaDataArrayOutput() {}
+    PktMetaDataArrayOutput(const shared_ptr<PktMetaDataArray > & _p, uint32_t _v, DetectorModel _m = DetectorModel::LONG_MODEL, const MTSKey & _k = MTSKey()): 
+                            p_flat_vec(_p), vol(_v), model(_m), enqueue_ts(get_time_spec()), key(_k) {}
+
+};
 
 struct FlowID {
 
@@ -191,654 +365,1229 @@ struct FlowEntry {
     bool forward_init = false;
     bool backward_init = false;
 
+    // 特征缓冲区写满后已提前发送给detector, 流表中只保留计数
+    bool early_emitted = false;
+
+    // 已有分段发送给detector(流式推断), 之后的分段与流的结束都发送给同一个detector
+    bool streamed = false;
+
 };
 
 
-// PktMetaDataArray: vector<{curr_ts, length, type}>
+// 流的类别, 用于过载时按类别丢弃(SHED_BY_CLASS)
+// 0-> TCP, 1-> UDP, 2-> others
+static inline uint32_t flow_class_of(const FlowID & flow_id) {
 
-// 所有流对应的元数据数组都由shared_ptr管理
+    if (flow_id.proto == 0x06) return 0;
+    if (flow_id.proto == 0x11) return 1;
+    return 2;
 
-class MTS {
+}
+
+static inline MTSKey mts_key_of(const FlowID & flow_id) {
+
+    // parser按网络字节序保存端口
+    return MTSKey(flow_id.low_ip, flow_id.high_ip, ntohs(static_cast<uint16_t >(flow_id.low_port)), ntohs(static_cast<uint16_t >(flow_id.high_port)), flow_id.proto);
+
+}
+
+// 流完成后的去向: 长流直接检测, 短流交给aggregator聚合, 或直接丢弃
+enum class FlowDestination : uint8_t { LONG = 0, SHORT = 1, DROP = 2 };
+
+// 分类表中的一条规则, 所有条件同时满足时命中
+struct FlowClassRule {
+
+    string name;
+
+    uint32_t min_len = 0;
+    uint32_t max_len = UINT32_MAX;
+    uint64_t min_vol = 0;
+    uint64_t max_vol = UINT64_MAX;
+
+    uint8_t proto = 0; // 0代表任意协议
+
+    // 任一端口落在区间内即满足 (主机字节序)
+    uint16_t min_port = 0;
+    uint16_t max_port = UINT16_MAX;
+
+    FlowDestination dest = FlowDestination::LONG;
+    DetectorModel model = DetectorModel::LONG_MODEL; // 仅对LONG去向生效, 短流聚合后总是使用aggr模型
+
+    bool match(const FlowID & flow_id, const FlowDataStats & stats) const {
+
+        if (stats.len < min_len || stats.len > max_len) return false;
+        if (stats.vol < min_vol || stats.vol > max_vol) return false;
+        if (proto != 0 && proto != flow_id.proto) return false;
+
+        // parser记录的端口为网络字节序
+        const uint16_t low_port = ntohs(static_cast<uint16_t >(flow_id.low_port));
+        const uint16_t high_port = ntohs(static_cast<uint16_t >(flow_id.high_port));
+
+        return (low_port >= min_port && low_port <= max_port) || (high_port >= min_port && high_port <= max_port);
+
+    }
+
+};
+
+// 按顺序匹配的流分类表, 第一条命中的规则决定流的去向与模型
+// 表尾总是附加两条默认规则, 与原先的long_th划分一致
+class FlowClassifier final {
 
     private:
 
-    // 记录没一个数据包的元数据: 到达时间戳, 数据包长度, 类型
-    shared_ptr<PktMetaDataArray > p_flat_vec;
+    vector<FlowClassRule > rules;
 
-    //
-    shared_ptr<PktMetaDataArray > get_flat_vec() const { return p_flat_vec; } 
+    unique_ptr<atomic<uint64_t >[] > class_flow_num;
+    unique_ptr<atomic<uint64_t >[] > class_vol;
 
-    void sort2mts() {
+    public:
 
-        PktMetaDataArray & _flat_vec = *p_flat_vec;
+    FlowClassifier() { load_params_via_json(json::array(), 40); }
 
-        auto merge = [&_flat_vec] (uint32_t left, uint32_t mid, uint32_t right) -> void {
+    virtual ~FlowClassifier() {}
+    FlowClassifier & operator=(const FlowClassifier &) = delete;
+    FlowClassifier(const FlowClassifier &) = delete;
 
-            uint32_t i = left, j = mid + 1;
+    void load_params_via_json(const json & jin, uint32_t long_th) {
 
-            while (i <= mid && j <= right) {
+        rules.clear();
 
-                if (_flat_vec[i * 3] <= _flat_vec[j * 3]) { i ++;
-                } else {
-                    
-                    for (uint32_t k = 0; k < 3; k ++) {
+        for (const auto & j_rule : jin) {
 
-                        uint64_t temp = _flat_vec[j * 3 + k];
-                        
-                        for (uint32_t l = j * 3 + k; l > i * 3 + k; l--) {
-                            
-                            _flat_vec[l] = _flat_vec[l - 1];
-                        
-                        }
-                        
-                        _flat_vec[i * 3 + k] = temp;
-                    }
+            FlowClassRule rule;
 
-                    i ++; mid ++; j ++;
+            rule.name = j_rule.count("name") ? j_rule["name"].get<string >() : "class_" + to_string(rules.size());
 
+            if (j_rule.count("min_len")) rule.min_len = static_cast<uint32_t >(j_rule["min_len"]);
+            if (j_rule.count("max_len")) rule.max_len = static_cast<uint32_t >(j_rule["max_len"]);
+            if (j_rule.count("min_vol")) rule.min_vol = static_cast<uint64_t >(j_rule["min_vol"]);
+            if (j_rule.count("max_vol")) rule.max_vol = static_cast<uint64_t >(j_rule["max_vol"]);
+            if (j_rule.count("proto")) rule.proto = static_cast<uint8_t >(j_rule["proto"]);
+
+            if (j_rule.count("port_range")) {
+                const vector<uint32_t > & port_range = j_rule["port_range"];
+                if (port_range.size() != 2 || port_range[0] > port_range[1] || port_range[1] > UINT16_MAX) {
+                    FATAL_ERROR("Parameter(port_range) of Flow Class Must be [min_port, max_port]!");
                 }
+                rule.min_port = port_range[0];
+                rule.max_port = port_range[1];
+            }
 
+            if (j_rule.count("dest")) {
+                const string & dest = j_rule["dest"];
+                if (dest == "long") rule.dest = FlowDestination::LONG;
+                else if (dest == "short") rule.dest = FlowDestination::SHORT;
+                else if (dest == "drop") rule.dest = FlowDestination::DROP;
+                else FATAL_ERROR("Parameter(dest) of Flow Class is Incorrect!");
+            } else {
+                FATAL_ERROR("Parameter(dest) of Flow Class is Missing!");
             }
 
-        };
+            if (j_rule.count("model")) {
+                const string & model = j_rule["model"];
+                if (model == "long") rule.model = DetectorModel::LONG_MODEL;
+                else if (model == "aggr") rule.model = DetectorModel::AGGR_MODEL;
+                else FATAL_ERROR("Parameter(model) of Flow Class is Incorrect!");
+            }
+
+            rules.push_back(rule);
+
+        }
+
+        FlowClassRule default_long, default_short;
+
+        default_long.name = "default_long";
+        default_long.min_len = long_th;
+        default_long.dest = FlowDestination::LONG;
+
+        default_short.name = "default_short";
+        default_short.dest = FlowDestination::SHORT;
+
+        rules.push_back(default_long);
+        rules.push_back(default_short);
+
+        class_flow_num.reset(new atomic<uint64_t >[rules.size()]());
+        class_vol.reset(new atomic<uint64_t >[rules.size()]());
+
+    }
+
+    // 返回命中规则的下标, 默认规则保证总能命中
+    size_t classify(const FlowID & flow_id, const FlowDataStats & stats) const {
+
+        for (size_t i = 0; i < rules.size(); i ++) {
+
+            if (rules[i].match(flow_id, stats)) return i;
+
+        }
+
+        return rules.size() - 1;
+
+    }
+
+    const FlowClassRule & get_rule(size_t class_id) const { return rules[class_id]; }
+
+    void record(size_t class_id, uint64_t vol) {
+
+        class_flow_num[class_id].fetch_add(1, memory_order_relaxed);
+        class_vol[class_id].fetch_add(vol, memory_order_relaxed);
+
+    }
+
+    void inline display_params() const {
+
+        const char * dest_name[] = {"long", "short", "drop"};
+        const char * model_name[] = {"long", "aggr"};
+
+        for (size_t i = 0; i < rules.size(); i ++) {
+
+            const FlowClassRule & rule = rules[i];
+
+            printf("Flow Class #%ld(%s) -> Len: [%u, %u], Vol: [%lu, %lu], Proto: %d, Port: [%d, %d], Dest: %s, Model: %s.\n", 
+                    i, rule.name.c_str(), rule.min_len, rule.max_len, rule.min_vol, rule.max_vol, rule.proto, 
+                    rule.min_port, rule.max_port, dest_name[static_cast<uint8_t >(rule.dest)], model_name[static_cast<uint8_t >(rule.model)]);
+
+        }
+
+    }
+
+    void inline display_stats() const {
+
+        for (size_t i = 0; i < rules.size(); i ++) {
+
+            printf("Flow Class #%ld(%s) -> Flows: %lu, Volume: %lu Bytes\n", i, rules[i].name.c_str(), 
+                    class_flow_num[i].load(memory_order_relaxed), class_vol[i].load(memory_order_relaxed));
+
+        }
+
+    }
+
+};
 
-        if (_flat_vec.size() % 3 != 0) { return; }
+// 队列达到高水位后的过载策略
+// BLOCK: 生产者等待消费者归还credit, 直至深度回落至低水位; 等待是在生产者的lcore上以yield自旋(不休眠, 期间持续占用该核心),
+//        深度达到容量时同样等待, 因此单生产者下容量是硬上限
+// SHED_NEWEST: 深度达到容量时丢弃新入队的元素
+// SHED_BY_CLASS: 过载期间丢弃shed_class_mask中指定类别的元素, 达到容量时丢弃新元素
+enum class OverloadPolicy : uint8_t { BLOCK = 0, SHED_NEWEST = 1, SHED_BY_CLASS = 2 };
 
-        uint32_t numTriplets = _flat_vec.size() / 3;
+struct BoundedQueueParam final {
 
-        // 从子数组大小为1开始，逐步扩大到整个数组
-        for (uint32_t size = 1; size < numTriplets; size *= 2) {
+    size_t capacity = 1 << 20;
+    size_t high_watermark = (1 << 20) - (1 << 17);
+    size_t low_watermark = 1 << 19;
 
-            for (uint32_t left = 0; left < numTriplets - size; left += 2 * size) {
+    OverloadPolicy policy = OverloadPolicy::SHED_NEWEST;
+    uint32_t shed_class_mask = 0;
 
-                uint32_t mid = left + size - 1;
-                uint32_t right = min(left + 2 * size - 1, numTriplets - 1);
+    BoundedQueueParam() = default;
+    BoundedQueueParam(size_t c, OverloadPolicy p): capacity(c), high_watermark(c - (c >> 3)), low_watermark(c >> 1), policy(p) {}
 
-                merge(left, mid, right);
+    void inline display_params(const char * queue_name) const {
+
+        const char * policy_name = policy == OverloadPolicy::BLOCK ? "block" : 
+                                   (policy == OverloadPolicy::SHED_NEWEST ? "shed_newest" : "shed_by_class");
+
+        printf("Queue(%s) -> Capacity: %ld, Watermarks: %ld/%ld, Overload Policy: %s", queue_name, capacity, high_watermark, low_watermark, policy_name);
+        if (policy == OverloadPolicy::SHED_BY_CLASS) printf(", Shed Class Mask: 0x%x", shed_class_mask);
+        printf(".\n");
+
+    }
+
+    // 缺省的键保持默认值, 只给出capacity时按比例推导高低水位
+    void load_params_via_json(const json & jin) {
+
+        if (jin.count("capacity")) {
+            capacity = static_cast<size_t>(jin["capacity"]);
+            high_watermark = capacity - (capacity >> 3);
+            low_watermark = capacity >> 1;
+        }
+
+        if (jin.count("high_watermark")) high_watermark = static_cast<size_t>(jin["high_watermark"]);
+        if (jin.count("low_watermark")) low_watermark = static_cast<size_t>(jin["low_watermark"]);
+
+        if (capacity == 0 || high_watermark > capacity || low_watermark > high_watermark) {
+            FATAL_ERROR("Queue Watermarks Must Satisfy: low_watermark <= high_watermark <= capacity (capacity > 0).");
+        }
+
+        if (jin.count("policy")) {
+            const string & policy_name = jin["policy"];
+            if (policy_name == "block") policy = OverloadPolicy::BLOCK;
+            else if (policy_name == "shed_newest") policy = OverloadPolicy::SHED_NEWEST;
+            else if (policy_name == "shed_by_class") policy = OverloadPolicy::SHED_BY_CLASS;
+            else FATAL_ERROR("Parameter(policy) of Queue is Incorrect!");
+        }
+
+        if (jin.count("shed_classes")) {
+            const vector<uint32_t> & class_vec = jin["shed_classes"];
+            shed_class_mask = 0;
+            for (const auto & _c : class_vec) {
+                if (_c >= 32) FATAL_ERROR("Parameter(shed_classes) of Queue Must be in [0, 32)!");
+                shed_class_mask |= (uint32_t(1) << _c);
             }
+        }
+
+    }
+
+};
+
+// 有界的阶段间队列, 深度作为credit在生产者与消费者之间流转
+// 多生产者时容量上限是近似的(可能被并发的push短暂超出)
+template <typename T >
+class BoundedQueue final {
+
+    private:
+
+    tbb::concurrent_queue<T > queue;
+
+    BoundedQueueParam param;
+
+    // BLOCK策略下生产者等待时检查的默认终止标记(单一生产者时为其m_stop), push/push_bulk可传入生产者自身的标记
+    const volatile bool * p_abort = nullptr;
+
+    atomic<size_t > depth{0};
+    atomic<size_t > max_depth{0};
+    atomic<bool > overloaded{false};
+
+    atomic<uint64_t > pushed_num{0};
+    atomic<uint64_t > dropped_num{0};
+    atomic<uint64_t > overload_num{0};
+
+    public:
+
+    BoundedQueue() = default;
+    BoundedQueue(const BoundedQueueParam & _p, const volatile bool * _a = nullptr): param(_p), p_abort(_a) {}
+
+    virtual ~BoundedQueue() {}
+    BoundedQueue & operator=(const BoundedQueue &) = delete;
+    BoundedQueue(const BoundedQueue &) = delete;
+
+    // 仅在生产者与消费者线程启动前调用
+    void configure(const BoundedQueueParam & _p, const volatile bool * _a) { param = _p; p_abort = _a; }
+
+    // _abort: 生产者自身的终止标记, 为空时使用configure给出的标记
+    bool push(T && item, uint32_t item_class = 0, const volatile bool * _abort = nullptr) {
+
+        const volatile bool * _stop = _abort ? _abort : p_abort;
+
+        const size_t curr_depth = depth.load(memory_order_relaxed);
+
+        if (curr_depth >= param.high_watermark && !overloaded.exchange(true, memory_order_relaxed)) overload_num ++;
+
+        switch (param.policy) {
+
+            case OverloadPolicy::BLOCK:
+
+                if (overloaded.load(memory_order_relaxed)) {
+
+                    while (depth.load(memory_order_acquire) > param.low_watermark) {
+
+                        if (_stop && *_stop) { dropped_num ++; return false; }
+
+                        this_thread::yield();
+
+                    }
+
+                }
+
+                while (depth.load(memory_order_acquire) >= param.capacity) {
+
+                    if (_stop && *_stop) { dropped_num ++; return false; }
+
+                    this_thread::yield();
+
+                }
+
+                break;
+
+            case OverloadPolicy::SHED_BY_CLASS:
+
+                if (overloaded.load(memory_order_relaxed) && ((param.shed_class_mask >> item_class) & 1)) { dropped_num ++; return false; }
+
+                if (curr_depth >= param.capacity) { dropped_num ++; return false; }
+
+                break;
+
+            case OverloadPolicy::SHED_NEWEST:
+
+                if (curr_depth >= param.capacity) { dropped_num ++; return false; }
+
+                break;
 
         }
+
+        queue.push(move(item));
+
+        const size_t next_depth = depth.fetch_add(1, memory_order_release) + 1;
+
+        size_t prev_max = max_depth.load(memory_order_relaxed);
+        while (next_depth > prev_max && !max_depth.compare_exchange_weak(prev_max, next_depth, memory_order_relaxed)) {}
+
+        pushed_num ++;
+
+        return true;
+
+    }
+
+    bool push(const T & item, uint32_t item_class = 0, const volatile bool * _abort = nullptr) { T _item(item); return push(move(_item), item_class, _abort); }
+
+    // 整批写入items中的元素: 过载策略对整批判定一次, 深度只更新一次; 超出容量的部分(items的尾部)被丢弃 (BLOCK策略下等待容量)
+    // 只有计数是整批的, 底层concurrent_queue仍逐个push; 返回成功写入的数量, 写入的元素被移出items
+    size_t push_bulk(vector<T > & items, uint32_t item_class = 0, const volatile bool * _abort = nullptr) {
+
+        if (items.empty()) return 0;
+
+        const volatile bool * _stop = _abort ? _abort : p_abort;
+
+        const size_t curr_depth = depth.load(memory_order_relaxed);
+
+        if (curr_depth >= param.high_watermark && !overloaded.exchange(true, memory_order_relaxed)) overload_num ++;
+
+        size_t accepted = items.size();
+
+        switch (param.policy) {
+
+            case OverloadPolicy::BLOCK:
+
+                if (overloaded.load(memory_order_relaxed)) {
+
+                    while (depth.load(memory_order_acquire) > param.low_watermark) {
+
+                        if (_stop && *_stop) { dropped_num += items.size(); return 0; }
+
+                        this_thread::yield();
+
+                    }
+
+                }
+
+                // 按剩余容量分段写入, 整批不会把深度推过容量
+                accepted = 0;
+
+                while (accepted < items.size()) {
+
+                    const size_t _depth = depth.load(memory_order_acquire);
+
+                    if (_depth >= param.capacity) {
+
+                        if (_stop && *_stop) break;
+
+                        this_thread::yield();
+
+                        continue;
+
+                    }
+
+                    const size_t _n = min(items.size() - accepted, param.capacity - _depth);
+
+                    for (size_t i = accepted; i < accepted + _n; i ++) queue.push(move(items[i]));
+
+                    const size_t next_depth = depth.fetch_add(_n, memory_order_release) + _n;
+
+                    size_t prev_max = max_depth.load(memory_order_relaxed);
+                    while (next_depth > prev_max && !max_depth.compare_exchange_weak(prev_max, next_depth, memory_order_relaxed)) {}
+
+                    accepted += _n;
+
+                }
+
+                pushed_num += accepted;
+                dropped_num += items.size() - accepted;
+
+                return accepted;
+
+            case OverloadPolicy::SHED_BY_CLASS:
+
+                if (overloaded.load(memory_order_relaxed) && ((param.shed_class_mask >> item_class) & 1)) { dropped_num += items.size(); return 0; }
+
+                accepted = min(accepted, param.capacity > curr_depth ? param.capacity - curr_depth : 0);
+
+                break;
+
+            case OverloadPolicy::SHED_NEWEST:
+
+                accepted = min(accepted, param.capacity > curr_depth ? param.capacity - curr_depth : 0);
+
+                break;
+
+        }
+
+        for (size_t i = 0; i < accepted; i ++) queue.push(move(items[i]));
+
+        if (accepted) {
+
+            const size_t next_depth = depth.fetch_add(accepted, memory_order_release) + accepted;
+
+            size_t prev_max = max_depth.load(memory_order_relaxed);
+            while (next_depth > prev_max && !max_depth.compare_exchange_weak(prev_max, next_depth, memory_order_relaxed)) {}
+
+            pushed_num += accepted;
+
+        }
+
+        dropped_num += items.size() - accepted;
+
+        return accepted;
+
+    }
+
+    bool try_pop(T & item) {
+
+        if (!queue.try_pop(item)) return false;
+
+        // 消费者归还credit, 回落至低水位时解除过载
+        if (depth.fetch_sub(1, memory_order_release) - 1 <= param.low_watermark) overloaded.store(false, memory_order_relaxed);
+
+        return true;
+
+    }
+
+    // 最多取出max_num个元素追加到items, 深度只更新一次(底层仍逐个try_pop); 队列为空时只读取深度计数, 不访问底层队列
+    size_t try_pop_bulk(vector<T > & items, size_t max_num) {
+
+        if (depth.load(memory_order_acquire) == 0) return 0;
+
+        size_t popped = 0;
+
+        T item;
+
+        while (popped < max_num && queue.try_pop(item)) {
+            items.push_back(move(item));
+            popped ++;
+        }
+
+        if (popped && depth.fetch_sub(popped, memory_order_release) - popped <= param.low_watermark) overloaded.store(false, memory_order_relaxed);
+
+        return popped;
+
+    }
+
+    size_t size() const { return depth.load(memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+    bool is_overloaded() const { return overloaded.load(memory_order_relaxed); }
+
+    size_t get_max_depth() const { return max_depth.load(memory_order_relaxed); }
+    uint64_t get_pushed_num() const { return pushed_num.load(memory_order_relaxed); }
+    uint64_t get_dropped_num() const { return dropped_num.load(memory_order_relaxed); }
+    uint64_t get_overload_num() const { return overload_num.load(memory_order_relaxed); }
+
+    void inline display_stats(const char * queue_name) const {
+
+        printf("Queue(%s) -> Depth: %ld/%ld (Max %ld), Pushed: %ld, Dropped: %ld, Overload Events: %ld%s\n", 
+                queue_name, size(), param.capacity, get_max_depth(), get_pushed_num(), get_dropped_num(), get_overload_num(), 
+                is_overloaded() ? " [OVERLOADED]" : "");
+
+    }
+
+};
+
+using PktMetaDataArrayOutputQueue = BoundedQueue<shared_ptr<PktMetaDataArrayOutput > >;
+
+// 短流的单个方向: 插入IPTrie时使用的IP(forward为low_ip, backward为high_ip)及该方向的统计数据
+using ShortFlowQueue = BoundedQueue<pair<uint32_t, FlowDataStats > >;
+
+// 流式分段按流划分至detector, 同一条流的各段由同一个detector按到达顺序处理
+static inline size_t stream_partition(const MTSKey & key, size_t partition_num) {
+
+    const uint32_t _h = static_cast<uint32_t >(MTSKeyHash()(key) >> 32);
+
+    return static_cast<size_t >((static_cast<uint64_t >(_h) * partition_num) >> 32);
+
+}
+
+// 把长流当前的特征缓冲区作为一段发送给负责该流的detector, 调用者持有该流在流表中的写锁; 返回是否写入成功
+static inline bool push_stream_chunk(const vector<shared_ptr<PktMetaDataArrayOutputQueue > > & queue_vec, const FlowID & flow_id, const FlowDataStats & stats, 
+                                        DetectorModel model, bool stream_end, const volatile bool * p_abort) {
+
+    shared_ptr<PktMetaDataArrayOutput > p_chunk = make_shared<PktMetaDataArrayOutput >(stats.p_flat_vec, stats.vol, model, mts_key_of(flow_id));
+    p_chunk->stream_len = stats.p_flat_vec->size() / 3;
+    p_chunk->stream_end = stream_end;
+
+    const size_t _k = stream_partition(p_chunk->key, queue_vec.size());
+
+    return queue_vec[_k]->push(move(p_chunk), flow_class_of(flow_id), p_abort);
+
+}
+
+// 短流按bound prefix划分至aggregator, 同一前缀的短流只会进入同一棵IPTrie
+static inline size_t bound_prefix_partition(uint32_t ip, uint32_t bound_prefix_mask, size_t partition_num) {
+
+    // 乘法散列, 避免/24等前缀的低位全为0
+    const uint32_t _h = (ip & bound_prefix_mask) * 2654435761u;
+
+    return static_cast<size_t >((static_cast<uint64_t >(_h) * partition_num) >> 32);
+
+}
+
+
+// PktMetaDataArray: vector<{curr_ts, length, type}>
+
+// 所有流对应的元数据数组都由shared_ptr管理
+
+// 指向某个run中前len个三元组的只读区间, 不持有数据
+struct MTSSpan {
+
+    const uint64_t * data = nullptr;
+    size_t len = 0;
+
+    MTSSpan() {}
+    MTSSpan(const uint64_t * _d, size_t _l): data(_d), len(_l) {}
+
+    uint64_t ts(size_t i) const { return data[i * 3]; }
+
+};
+
+// MTS由若干有序段(run)组成, 每个run是一条流的元数据数组, 已按时间戳有序
+// 叶子持有run, 聚合时父节点只以下标引用被合并的节点(见TrieNode::merged), 不拷贝任何数据
+// 发送时才收集所有run的区间并多路归并为一条时间序列
+class MTS {
+
+    private:
+
+    // 记录每一个数据包的元数据: 到达时间戳, 数据包长度, 类型
+    vector<shared_ptr<PktMetaDataArray > > runs;
+
+    // 所有run的三元组总数
+    size_t total_len = 0;
+
+    static void append(PktMetaDataArray & out, const MTSSpan & span, size_t from, size_t to) {
+
+        out.insert(out.end(), span.data + from * 3, span.data + to * 3);
+
+    }
+
+    // 在span的[from, end)个三元组中查找第一个时间戳大于key(inclusive)或不小于key的位置, 指数搜索后二分
+    static size_t gallop(const MTSSpan & span, size_t from, uint64_t key, bool inclusive) {
+
+        auto before = [&] (size_t i) -> bool { return inclusive ? span.ts(i) <= key : span.ts(i) < key; };
+
+        size_t lo = from, hi = from, step = 1;
+
+        while (hi < span.len && before(hi)) { lo = hi + 1; hi = from + step; step <<= 1; }
+
+        hi = min(hi, span.len);
+
+        while (lo < hi) {
+
+            size_t mid = lo + ((hi - lo) >> 1);
+
+            if (before(mid)) lo = mid + 1;
+            else hi = mid;
+
+        }
+
+        return lo;
+
+    }
+
+    // 两个run: 交替地整段拷贝(galloping), 时间戳相同时先取先插入的run
+    static void merge2(PktMetaDataArray & out, const MTSSpan & a, const MTSSpan & b, size_t max_len) {
+
+        size_t i = 0, j = 0;
+
+        while (i < a.len && j < b.len && out.size() / 3 < max_len) {
+
+            size_t remain = max_len - out.size() / 3;
+
+            size_t i_end = min(gallop(a, i, b.ts(j), true), i + remain);
+            append(out, a, i, i_end); i = i_end;
+
+            if (i == a.len) break;
+
+            remain = max_len - out.size() / 3;
+
+            size_t j_end = min(gallop(b, j, a.ts(i), false), j + remain);
+            append(out, b, j, j_end); j = j_end;
+
+        }
+
+        if (i < a.len) append(out, a, i, min(a.len, i + max_len - out.size() / 3));
+        if (j < b.len) append(out, b, j, min(b.len, j + max_len - out.size() / 3));
+
+    }
+
+    // k个run: 以(时间戳, run序号)为键的小顶堆
+    static void merge_k(PktMetaDataArray & out, const vector<MTSSpan > & spans, size_t max_len) {
+
+        using HeapItem = tuple<uint64_t, uint32_t, uint32_t >; // 时间戳, run序号, 三元组下标
+
+        vector<HeapItem > heap_vec;
+        heap_vec.reserve(spans.size());
+
+        for (uint32_t r = 0; r < spans.size(); r ++) heap_vec.emplace_back(spans[r].ts(0), r, 0);
+
+        priority_queue<HeapItem, vector<HeapItem >, greater<HeapItem > > heap(greater<HeapItem >(), move(heap_vec));
+
+        while (!heap.empty() && out.size() / 3 < max_len) {
+
+            const HeapItem top = heap.top(); heap.pop();
+
+            const MTSSpan & span = spans[get<1>(top)];
+            const uint32_t pos = get<2>(top);
+
+            append(out, span, pos, pos + 1);
+
+            if (pos + 1 < span.len) heap.emplace(span.ts(pos + 1), get<1>(top), pos + 1);
+
+        }
+
     }
 
     public:
 
-    MTS() { p_flat_vec = make_shared<PktMetaDataArray >(); }
+    MTS() {}
 
-    // 按值传递shared_ptr更安全, 会使其引用计数自增
+    // 只保存run的引用, 不拷贝数据; run在插入后不再被修改
     void insert(const shared_ptr<PktMetaDataArray > & _p_flat_vec) {
 
-        if (_p_flat_vec && !_p_flat_vec->empty()) { p_flat_vec->insert(p_flat_vec->end(), _p_flat_vec->begin(), _p_flat_vec->end()); }
+        if (_p_flat_vec && _p_flat_vec->size() >= 3) { 
+            
+            runs.push_back(_p_flat_vec); 
+            total_len += _p_flat_vec->size() / 3; 
+        
+        }
 
     }
 
-    void insert(const MTS & _mts) { 
+    // 移动另一个只含run的MTS(叶子节点)的所有run
+    void absorb(MTS && _mts) {
+
+        runs.insert(runs.end(), make_move_iterator(_mts.runs.begin()), make_move_iterator(_mts.runs.end()));
+        total_len += _mts.total_len;
+
+        _mts.clear();
 
-        shared_ptr<PktMetaDataArray > _p_flat_vec = _mts.get_flat_vec();
-        
-        insert(_p_flat_vec);
-        
     }
 
-    shared_ptr<PktMetaDataArray > get_mts() {
+    void clear() { runs.clear(); total_len = 0; }
 
-        sort2mts();
+    void collect_spans(vector<MTSSpan > & spans, size_t max_len) const {
+
+        for (const auto & _run : runs) spans.emplace_back(_run->data(), min(_run->size() / 3, max_len));
+
+    }
+
+    // 归并spans中的所有区间, 归并过程中截断至max_len个数据包; 这是唯一一次拷贝数据
+    static shared_ptr<PktMetaDataArray > merge_spans(const vector<MTSSpan > & spans, size_t max_len) {
+
+        shared_ptr<PktMetaDataArray > p_flat_vec = make_shared<PktMetaDataArray >();
+
+        size_t _total = 0;
+        for (const auto & span : spans) _total += span.len;
+
+        p_flat_vec->reserve(min(_total, max_len) * 3);
+
+        if (spans.size() == 1) append(*p_flat_vec, spans[0], 0, spans[0].len);
+        else if (spans.size() == 2) merge2(*p_flat_vec, spans[0], spans[1], max_len);
+        else if (spans.size() > 2) merge_k(*p_flat_vec, spans, max_len);
 
         return p_flat_vec;
 
     }
 
-    uint32_t size() { return p_flat_vec->size(); }
+    shared_ptr<PktMetaDataArray > get_mts(size_t max_len = numeric_limits<size_t >::max()) const {
+
+        vector<MTSSpan > spans;
+        collect_spans(spans, max_len);
+
+        return merge_spans(spans, max_len);
+
+    }
+
+    uint32_t size() const { return total_len * 3; }
 
 };
 
 // 左0右1
-// 记录所有的is_end节点
+// 节点按下标保存在所属IPTrie的arena中, 下标TRIE_NIL表示空节点
+
+using trie_node_idx_t = uint32_t;
 
-// 最大的深度
+static const trie_node_idx_t TRIE_NIL = 0xffffffff;
 
+// 路径压缩: 只有单个孩子的节点链被合并为一条边, 节点记录自身的完整前缀与前缀长度
+// 叶子节点(prefix_len == 32)对应一个IP地址
 struct TrieNode {
 
-    vector<shared_ptr<TrieNode > > children = vector<shared_ptr<TrieNode > >(2, nullptr);
-    weak_ptr<TrieNode > parent;
+    trie_node_idx_t children[2] = {TRIE_NIL, TRIE_NIL};
 
-    // 节点自身属性
-    bool is_end; // 截止至当前节点是否构成一个IP前缀, 是否为空节点
-    uint16_t type = 2; // 2代表根节点, 0代表左节点, 1代表右节点
+    uint32_t prefix = 0;
+    uint8_t prefix_len = 0;
 
     // 节点包含数据, 与聚合流关联(多维时间序列数据, 聚合的个数)
+    // 叶子节点的数据保存在aggr_flow中; 分叉节点的数据由聚合时合并的两个节点(同一arena中的下标)组成, 下标不随arena扩容失效
     MTS aggr_flow;
+    trie_node_idx_t merged[2] = {TRIE_NIL, TRIE_NIL};
     uint64_t aggr_len = 0;
     uint64_t aggr_vol = 0;
 
-    TrieNode() : is_end(false) {}
-    TrieNode(uint16_t t) : is_end(false), type(t) {}
+    TrieNode() {}
+    TrieNode(uint32_t p, uint8_t l) : prefix(p), prefix_len(l) {}
 
 };
 
 // unique_ptr<IPTrie > 
 // 按批次聚合, 聚合后传递给检测模块
+// 聚合完成后调用reset()清空arena(保留容量), 同一棵IPTrie可在下一个aggr_cycle中复用
+// 增量模式下IPTrie长期存在: absorb()吸收每个周期的新流, aggregate_incremental()只重新聚合有变化的bound子树,
+// 未达到阈值的数据留在Trie中继续累积, 长时间没有更新的bound prefix老化后发送剩余数据并删除
 class IPTrie {
 
-    // using IPTrieLeaves = tbb::concurrent_hash_map<shared_ptr<TrieNode >, uint8_t >;
-    using IPTrieLeaves = unordered_set<shared_ptr<TrieNode > >;
-
     private:
 
-    IPTrieLeaves left_leaves; // 包含了所有左叶子节点
-    IPTrieLeaves right_leaves; // 包含了所有没有左兄弟的右叶子节点
+    // 每个边界前缀(bound prefix)对应一个根节点
+    struct TrieBound {
 
-    unordered_map<uint32_t, shared_ptr<TrieNode > > path2bound;
+        trie_node_idx_t root = TRIE_NIL;
+
+        // 上次增量聚合之后是否有新的流插入
+        bool dirty = false;
+
+        // 最近一次插入的时间(秒), 用于增量模式下的老化
+        double_t last_update_ts = 0;
+
+    };
+
+    // 所有节点的arena, 释放整棵Trie只需清空该数组
+    vector<TrieNode > nodes;
+
+    unordered_map<uint32_t, TrieBound > path2bound;
+
+    // 已老化删除的bound子树在arena中遗留的节点数, 超过一半时压缩arena
+    size_t garbage_num = 0;
 
     uint32_t bound_prefix_length = 24;
     uint32_t bound_prefix_mask = 0xffffff00;
-    uint32_t traverse_init_mask = 0x00000080;
 
     uint64_t aggr_len_th = 500;
     uint32_t trunc_flow_len = 1000;
 
-    shared_ptr<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > > p_output;
+    shared_ptr<PktMetaDataArrayOutputQueue > p_output;
 
-    public:
+    // 写入p_output时BLOCK策略下检查的终止标记(所属aggregator的m_stop)
+    const volatile bool * p_output_abort = nullptr;
 
-    IPTrie() { 
-        
-        p_output = make_shared<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > >();
-        
-    }
+    static inline uint32_t prefix_mask(uint32_t len) { return len == 0 ? 0 : ~uint32_t(0) << (32 - len); }
+
+    // 前缀之后的下一位, 决定走向左孩子还是右孩子
+    static inline uint32_t next_bit(uint32_t ip, uint32_t len) { return (ip >> (31 - len)) & 1; }
+
+    trie_node_idx_t new_node(uint32_t prefix, uint32_t len) {
+
+        nodes.emplace_back(prefix & prefix_mask(len), static_cast<uint8_t >(len));
+
+        return static_cast<trie_node_idx_t >(nodes.size() - 1);
 
-    IPTrie(uint32_t b, uint64_t a, uint32_t t,
-            shared_ptr<tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > > p_o) : 
-                 bound_prefix_length(b), aggr_len_th(a), trunc_flow_len(t), p_output(p_o) { 
-        
-        bound_prefix_mask = ~((uint32_t(1) << (32 - bound_prefix_length)) - uint32_t(1));
-        if (bound_prefix_length == 32) traverse_init_mask = 0x0;
-        else traverse_init_mask = uint32_t(0x80000000) >> bound_prefix_length;  
-        
     }
 
-    void insert(const uint32_t & ip, const FlowDataStats & _stats) {
+    // 找到(必要时创建)ip对应的叶子节点, 并标记所在的bound
+    trie_node_idx_t locate_leaf(uint32_t ip, double_t ts) {
 
         uint32_t bound_prefix = ip & bound_prefix_mask;
 
-        if (path2bound.find(bound_prefix) == path2bound.end()) {
+        TrieBound & bound = path2bound[bound_prefix];
 
-            path2bound[bound_prefix] = make_shared<TrieNode >(2);
+        if (bound.root == TRIE_NIL) bound.root = new_node(bound_prefix, bound_prefix_length);
 
-        }
+        bound.dirty = true;
+        bound.last_update_ts = ts;
 
-        shared_ptr<TrieNode > node = path2bound[bound_prefix];
+        trie_node_idx_t idx = bound.root;
 
-        uint32_t _bit;
+        // 时间复杂度: O(分叉节点数), 不超过32 - bound_prefix_length
+        while (nodes[idx].prefix_len < 32) {
 
-        // 时间复杂度: O(32 - bound_prefix_length)
-        for (uint32_t m = traverse_init_mask; m > 0; m >>= 1) {
+            const uint32_t _len = nodes[idx].prefix_len;
+            const uint32_t _bit = next_bit(ip, _len);
 
-            _bit = (m & ip) == 0 ? 0 : 1;
+            const trie_node_idx_t child = nodes[idx].children[_bit];
 
-            if (!node->children[_bit]) { 
-                
-                node->children[_bit] = make_shared<TrieNode >(_bit);
-                node->children[_bit]->parent = node; 
+            if (child == TRIE_NIL) {
 
-            }
+                const trie_node_idx_t leaf = new_node(ip, 32);
+                nodes[idx].children[_bit] = leaf;
 
-            node = node->children[_bit];
+                return leaf;
 
-        }
+            }
 
-        // 更新当前节点的mts
-        if (!node->is_end) { node->is_end = true; }
+            const uint32_t diff = (ip ^ nodes[child].prefix) & prefix_mask(nodes[child].prefix_len);
 
-        if (node->aggr_len < trunc_flow_len) {
+            if (diff == 0) { idx = child; continue; }
 
-            node->aggr_flow.insert(_stats.p_flat_vec); node->aggr_len += _stats.len;
-            node->aggr_vol += _stats.vol;
+            // 压缩路径在公共前缀之后分叉, 插入新的分叉节点
+            const uint32_t common_len = __builtin_clz(diff);
 
-        } else {
+            const trie_node_idx_t fork = new_node(ip, common_len);
+            const trie_node_idx_t leaf = new_node(ip, 32);
 
-            node->aggr_len += _stats.len;
-            node->aggr_vol += _stats.vol;
+            nodes[fork].children[next_bit(nodes[child].prefix, common_len)] = child;
+            nodes[fork].children[next_bit(ip, common_len)] = leaf;
+            nodes[idx].children[_bit] = fork;
+
+            return leaf;
 
         }
 
-        // 维护叶子节点集合
-        if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
+        return idx;
 
-            // IPTrieLeaves::accessor acc;
+    }
 
-            if (node->type == 0) { // 当前叶子节点是左节点
+    // 清空子树中所有节点的数据(增量模式下发送之后)
+    void clear_subtree(trie_node_idx_t idx) {
 
-                // 直接插入左叶子节点集合                
-                // if (!left_leaves.find(acc, node)) left_leaves.insert(acc, node);
-                left_leaves.insert(node);
-                
-                // 同时, 如果当前左叶子节点有右兄弟, 则从右叶子节点集合中删除
-                shared_ptr<TrieNode > sibling = node_parent->children[1];
-                
-                if (sibling) { 
+        TrieNode & node = nodes[idx];
 
-                    // if (right_leaves.find(acc, sibling)) right_leaves.erase(acc); 
-                    right_leaves.erase(sibling);
+        node.aggr_flow.clear();
+        node.merged[0] = node.merged[1] = TRIE_NIL;
+        node.aggr_len = 0;
+        node.aggr_vol = 0;
 
-                }
-            
-            } else if (node->type == 1) { // 当前叶子节点是右节点
+        for (const auto & child : node.children) if (child != TRIE_NIL) clear_subtree(child);
 
-                shared_ptr<TrieNode > sibling = node_parent->children[0];
-                
-                if (!sibling) { 
+    }
 
-                    // if (!right_leaves.find(acc, node)) right_leaves.insert(acc, node); 
-                    right_leaves.insert(node);
+    // 清空子树中分叉节点上一次聚合留下的结果, 叶子节点的数据保留
+    void reset_aggregates(trie_node_idx_t idx) {
 
-                }
+        TrieNode & node = nodes[idx];
 
-            }
+        if (node.prefix_len == 32) return;
 
-        } else {
+        node.aggr_flow.clear();
+        node.merged[0] = node.merged[1] = TRIE_NIL;
+        node.aggr_len = 0;
+        node.aggr_vol = 0;
 
-            // IPTrieLeaves::accessor acc;
-            // if (!left_leaves.find(acc, node)) left_leaves.insert(acc, node);
-            left_leaves.insert(node);
+        for (const auto & child : node.children) if (child != TRIE_NIL) reset_aggregates(child);
 
-        }
+    }
+
+    size_t subtree_size(trie_node_idx_t idx) const {
+
+        size_t _size = 1;
+
+        for (const auto & child : nodes[idx].children) if (child != TRIE_NIL) _size += subtree_size(child);
+
+        return _size;
 
     }
 
-    // 叶子节点聚合时, 成对出现的兄弟节点考虑是否将数据聚合传递给父节点; 而落单的叶子节点, 直接将数据传递给父节点 
-    uint32_t aggregate() {
+    // 将子树移动至新的arena, 返回新的下标
+    trie_node_idx_t move_subtree(trie_node_idx_t idx, vector<TrieNode > & compacted) {
 
-        // sem_t semaphore;
-        // sem_init(&semaphore, 0, 1);
+        const trie_node_idx_t new_idx = static_cast<trie_node_idx_t >(compacted.size());
 
-        uint32_t curr_aggr_pkt_len = 0;
+        compacted.push_back(move(nodes[idx]));
 
-        while (!left_leaves.empty() || !right_leaves.empty()) {
+        for (uint32_t _bit = 0; _bit < 2; _bit ++) {
 
-            IPTrieLeaves next_left_leaves, next_right_leaves;
-            IPTrieLeaves next_all_leaves;
+            const trie_node_idx_t child = compacted[new_idx].children[_bit];
 
-            // 当前轮次所有新聚合的叶子节点先加入next_all_leaves
-            // 之后再分类至next_left_leaves, next_right_leaves
+            if (child != TRIE_NIL) {
 
-            for (const auto & node : left_leaves) {
+                const trie_node_idx_t new_child = move_subtree(child, compacted);
+                compacted[new_idx].children[_bit] = new_child;
 
-                if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
+            }
 
-                    if (shared_ptr<TrieNode > sibling = node_parent->children[1]) {
+        }
 
-                        // 当前的左叶子节点node具有兄弟节点sibling, 执行条件聚合
+        return new_idx;
 
-                        // 满足聚合条件, 将node与sibling的MTS加入它们的父节点, 父节点加入叶子节点集合
-                        // node从p_left_leaves中删去, node_parent考虑加入p_next_left/right_leaves
+    }
 
-                        if (node->aggr_len >= aggr_len_th && sibling->aggr_len >= aggr_len_th) {
+    // 丢弃老化的bound子树遗留的节点; 分叉节点的聚合结果引用旧arena中的下标, 需先清空
+    void compact() {
 
-                            shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                            shared_ptr<PktMetaDataArrayOutput > p1 = make_shared<PktMetaDataArrayOutput >(sibling->aggr_flow.get_mts(), sibling->aggr_vol);
-                            
-                            if (p_output) p_output->push(p0);
-                            if (p_output) p_output->push(p1);
+        vector<TrieNode > compacted;
+        compacted.reserve(nodes.size() - garbage_num);
 
-                            curr_aggr_pkt_len += node->aggr_vol;
-                            curr_aggr_pkt_len += sibling->aggr_vol;
+        for (auto & bound : path2bound) {
 
-                        } else {
+            reset_aggregates(bound.second.root);
+            bound.second.root = move_subtree(bound.second.root, compacted);
 
-                            node_parent->aggr_flow.insert(node->aggr_flow);
-                            node_parent->aggr_flow.insert(sibling->aggr_flow);
+        }
 
-                            node_parent->is_end = true;
-                            node_parent->aggr_len = node->aggr_len + sibling->aggr_len; 
-                            node_parent->aggr_vol = node->aggr_vol + sibling->aggr_vol; 
+        nodes.swap(compacted);
+        garbage_num = 0;
 
-                            next_all_leaves.insert(node_parent);
+    }
 
-                        }
+    // 聚合线程本地的输出缓冲, 攒够一批后整批写入p_output
+    struct AggrOutputBuffer {
 
-                    } else { // 当前的左叶子节点node不具有兄弟节点sibling
+        vector<shared_ptr<PktMetaDataArrayOutput > > items;
+        uint64_t vol = 0;
 
-                        if (node->aggr_len >= aggr_len_th) {
-                            
-                            shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                            
-                            if (p_output) p_output->push(p0);
+    };
 
-                            curr_aggr_pkt_len += node->aggr_vol;
+    static const size_t AGGR_OUTPUT_BATCH = 64;
 
-                        } else {
+    void flush(AggrOutputBuffer & buf) {
 
-                            // 聚合数量不够, 将数据传递至父节点, 继续聚合
-                            // node_parent加入next_all_leaves
+        if (p_output) p_output->push_bulk(buf.items, 0, p_output_abort);
+        buf.items.clear();
 
-                            node_parent->aggr_flow.insert(node->aggr_flow);
+    }
 
-                            node_parent->is_end = true;
-                            node_parent->aggr_len = node->aggr_len;
-                            node_parent->aggr_vol = node->aggr_vol; 
+    // 收集以idx为代表的数据的所有run: 叶子节点自身的run, 以及分叉节点合并的节点
+    void collect_spans(trie_node_idx_t idx, vector<MTSSpan > & spans) const {
 
-                            next_all_leaves.insert(node_parent);
+        const TrieNode & node = nodes[idx];
 
-                        }
+        node.aggr_flow.collect_spans(spans, trunc_flow_len);
 
-                    }
-                
-                } else {
+        for (const auto & _m : node.merged) if (_m != TRIE_NIL) collect_spans(_m, spans);
 
-                    if (node->aggr_len != 0) { 
-                        
-                        shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                            
-                        if (p_output) p_output->push(p0);
+    }
 
-                        curr_aggr_pkt_len += node->aggr_vol;
+    // clear_on_emit (增量模式): 发送后清空被发送子树的数据, 避免重复发送
+    void emit(trie_node_idx_t idx, bool clear_on_emit, AggrOutputBuffer & buf) {
 
-                    }
+        TrieNode & node = nodes[idx];
 
-                } 
+        vector<MTSSpan > spans;
+        collect_spans(idx, spans);
 
-            }
+        buf.items.push_back(make_shared<PktMetaDataArrayOutput >(MTS::merge_spans(spans, trunc_flow_len), node.aggr_vol, DetectorModel::AGGR_MODEL, MTSKey(node.prefix, node.prefix_len)));
+        buf.vol += node.aggr_vol;
 
-            for (const auto & node : right_leaves) {
+        if (clear_on_emit) clear_subtree(idx);
 
-                if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
+        if (buf.items.size() >= AGGR_OUTPUT_BATCH) flush(buf);
 
-                    if (node->aggr_len >= aggr_len_th) {
+    }
 
-                        shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                            
-                        if (p_output) p_output->push(p0);
+    // 自底向上聚合以idx为根的子树, 返回携带未发送数据的节点(TRIE_NIL表示子树数据已全部发送)
+    // 与原实现(逐层聚合叶子节点)一致: 成对出现的兄弟节点都满足阈值时各自发送, 否则合并至父节点; 
+    // 落单的节点满足阈值时发送, 否则直接上传. 压缩路径跳过的每一层上节点都是落单的, 数据不变, 因此只需判定一次;
+    // 右兄弟子树的数据已全部发送时, 左孩子仍按成对处理(与空的右兄弟合并, 即使满足阈值), 左兄弟子树的数据已全部发送时, 右孩子视为落单
+    trie_node_idx_t aggregate_subtree(trie_node_idx_t idx, bool clear_on_emit, AggrOutputBuffer & buf) {
 
-                        curr_aggr_pkt_len += node->aggr_vol;
+        if (nodes[idx].prefix_len == 32) return nodes[idx].aggr_len != 0 ? idx : TRIE_NIL;
 
-                    } else { 
+        const bool paired = nodes[idx].children[0] != TRIE_NIL && nodes[idx].children[1] != TRIE_NIL;
 
-                        node_parent->aggr_flow.insert(node->aggr_flow);
-                            
-                        node_parent->is_end = true;
-                        node_parent->aggr_len = node->aggr_len;
-                        node_parent->aggr_vol = node->aggr_vol; 
+        trie_node_idx_t c_vec[2] = {TRIE_NIL, TRIE_NIL};
 
-                        next_all_leaves.insert(node_parent);
+        for (uint32_t _bit = 0; _bit < 2; _bit ++) {
 
-                    }
+            const trie_node_idx_t child = nodes[idx].children[_bit];
 
-                } else {
+            if (child == TRIE_NIL) continue;
 
-                    if (node->aggr_len != 0) { 
-                        
-                        shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                            
-                        if (p_output) p_output->push(p0);
+            c_vec[_bit] = aggregate_subtree(child, clear_on_emit, buf);
 
-                        curr_aggr_pkt_len += node->aggr_vol;
-                        
-                    }
+            // 孩子与当前节点之间被压缩的层上, 孩子的数据沿落单的路径上传
+            if (c_vec[_bit] != TRIE_NIL && nodes[child].prefix_len > nodes[idx].prefix_len + 1 && nodes[c_vec[_bit]].aggr_len >= aggr_len_th) {
 
-                }
+                emit(c_vec[_bit], clear_on_emit, buf);
+                c_vec[_bit] = TRIE_NIL;
 
             }
 
+        }
 
+        const trie_node_idx_t c0 = c_vec[0], c1 = c_vec[1];
 
-            // auto aggr_left_leaves = [&, this] () {
+        if (c0 != TRIE_NIL && c1 != TRIE_NIL) {
 
-            //     tbb::parallel_for_each(left_leaves.begin(), left_leaves.end(), [&] (auto && item) {
+            if (nodes[c0].aggr_len >= aggr_len_th && nodes[c1].aggr_len >= aggr_len_th) {
 
-            //         shared_ptr<TrieNode > node = item.first;
+                emit(c0, clear_on_emit, buf);
+                emit(c1, clear_on_emit, buf);
 
-            //         if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
+                return TRIE_NIL;
 
-            //             if (shared_ptr<TrieNode > sibling = node_parent->children[1]) {
+            }
 
-            //                 // 当前的左叶子节点node具有兄弟节点sibling, 执行条件聚合
+            TrieNode & node = nodes[idx];
 
-            //                 // 满足聚合条件, 将node与sibling的MTS加入它们的父节点, 父节点加入叶子节点集合
-            //                 // node从p_left_leaves中删去, node_parent考虑加入p_next_left/right_leaves
+            node.merged[0] = c0;
+            node.merged[1] = c1;
 
-            //                 if (node->aggr_len >= aggr_len_th && sibling->aggr_len >= aggr_len_th) {
+            node.aggr_len = nodes[c0].aggr_len + nodes[c1].aggr_len;
+            node.aggr_vol = nodes[c0].aggr_vol + nodes[c1].aggr_vol;
 
-            //                     shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-            //                     shared_ptr<PktMetaDataArrayOutput > p1 = make_shared<PktMetaDataArrayOutput >(sibling->aggr_flow.get_mts(), sibling->aggr_vol);
-                                
-            //                     if (p_output) p_output->push(p0);
-            //                     if (p_output) p_output->push(p1);
+            return idx;
 
-            //                     sem_wait(&semaphore);
-            //                     curr_aggr_pkt_len += node->aggr_vol;
-            //                     curr_aggr_pkt_len += sibling->aggr_vol;
-            //                     sem_post(&semaphore);
+        }
 
-            //                 } else {
+        const trie_node_idx_t c = c0 != TRIE_NIL ? c0 : c1;
 
-            //                     node_parent->aggr_flow.insert(node->aggr_flow);
-            //                     node_parent->aggr_flow.insert(sibling->aggr_flow);
+        if (c != TRIE_NIL && !(paired && c == c0) && nodes[c].aggr_len >= aggr_len_th) {
 
-            //                     node_parent->is_end = true;
-            //                     node_parent->aggr_len = node->aggr_len + sibling->aggr_len; 
-            //                     node_parent->aggr_vol = node->aggr_vol + sibling->aggr_vol; 
-                                
-            //                     // cout << 1 << endl;
+            emit(c, clear_on_emit, buf);
 
-            //                     IPTrieLeaves::accessor acc;
-            //                     if (!next_all_leaves.find(acc, node_parent)) next_all_leaves.insert(acc, node_parent);
+            return TRIE_NIL;
 
-            //                 }
+        }
 
-            //             } else { // 当前的左叶子节点node不具有兄弟节点sibling
+        // 聚合数量不够, 不复制数据, 由孩子节点代表当前节点继续上传
+        return c;
 
-            //                 if (node->aggr_len >= aggr_len_th) {
-                                
-            //                     shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                                
-            //                     if (p_output) p_output->push(p0);
+    }
 
-            //                     sem_wait(&semaphore);
-            //                     curr_aggr_pkt_len += node->aggr_vol;
-            //                     sem_post(&semaphore);
+    // 聚合bounds[begin, end)中的各个bound子树, 不同bound的子树互不相交
+    // flush_residual: 聚合至aggr_bound仍未达到阈值的数据是否也发送(批量模式与老化的bound)
+    void aggregate_bounds(const vector<trie_node_idx_t > & bounds, size_t begin, size_t end, bool flush_residual, bool clear_on_emit, AggrOutputBuffer & buf) {
 
+        for (size_t i = begin; i < end; i ++) {
 
-            //                 } else {
+            if (clear_on_emit) reset_aggregates(bounds[i]);
 
-            //                     // 聚合数量不够, 将数据传递至父节点, 继续聚合
-            //                     // node_parent加入next_all_leaves
+            // 聚合至aggr_bound的节点直接向output添加聚合的结果
+            const trie_node_idx_t idx = aggregate_subtree(bounds[i], clear_on_emit, buf);
 
-            //                     node_parent->aggr_flow.insert(node->aggr_flow);
+            if (idx != TRIE_NIL && (flush_residual || nodes[idx].aggr_len >= aggr_len_th)) emit(idx, clear_on_emit, buf);
 
-            //                     node_parent->is_end = true;
-            //                     node_parent->aggr_len = node->aggr_len;
-            //                     node_parent->aggr_vol = node->aggr_vol; 
+        }
 
-            //                     IPTrieLeaves::accessor acc;
-            //                     if (!next_all_leaves.find(acc, node_parent)) next_all_leaves.insert(acc, node_parent);
+    }
 
-            //                 }
+    // 各bound prefix的子树在p_arena中并行聚合, 结果先写入线程本地缓冲再整批写入p_output
+    // p_arena为空或只有一个slot时在调用线程上串行执行
+    uint64_t run_bounds(const vector<trie_node_idx_t > & bounds, bool flush_residual, bool clear_on_emit, tbb::task_arena * p_arena) {
 
-            //             }
-                    
-            //         } else {
+        if (!p_arena || p_arena->max_concurrency() <= 1 || bounds.size() < 2) {
 
-            //             if (node->aggr_len != 0) { 
-                            
-            //                 shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                                
-            //                 if (p_output) p_output->push(p0);
+            AggrOutputBuffer buf;
 
-            //                 sem_wait(&semaphore);
-            //                 curr_aggr_pkt_len += node->aggr_vol;
-            //                 sem_post(&semaphore);
+            aggregate_bounds(bounds, 0, bounds.size(), flush_residual, clear_on_emit, buf);
+            flush(buf);
 
-            //             }
+            return buf.vol;
 
-            //         }
+        }
 
-            //     });
+        tbb::enumerable_thread_specific<AggrOutputBuffer > local_bufs;
 
-            // };
+        p_arena->execute([&] () {
 
-            // auto aggr_right_leaves = [&, this] () {
-            
-            //     tbb::parallel_for_each(right_leaves.begin(), right_leaves.end(), [&] (auto && item) {
+            tbb::parallel_for(tbb::blocked_range<size_t >(0, bounds.size(), 8), [&] (const tbb::blocked_range<size_t > & r) {
+
+                aggregate_bounds(bounds, r.begin(), r.end(), flush_residual, clear_on_emit, local_bufs.local());
 
-            //         shared_ptr<TrieNode > node = item.first;
+            });
 
-            //         if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
+        });
 
-            //             if (node->aggr_len >= aggr_len_th) {
+        uint64_t curr_aggr_pkt_len = 0;
 
-            //                 shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                                
-            //                 if (p_output) p_output->push(p0);
+        for (auto & buf : local_bufs) {
 
-            //                 sem_wait(&semaphore);
-            //                 curr_aggr_pkt_len += node->aggr_vol;
-            //                 sem_post(&semaphore);
+            flush(buf);
+            curr_aggr_pkt_len += buf.vol;
 
-            //             } else { 
+        }
 
-            //                 node_parent->aggr_flow.insert(node->aggr_flow);
-                                
-            //                 node_parent->is_end = true;
-            //                 node_parent->aggr_len = node->aggr_len;
-            //                 node_parent->aggr_vol = node->aggr_vol; 
+        return curr_aggr_pkt_len;
 
-            //                 IPTrieLeaves::accessor acc;
-            //                 if (!next_all_leaves.find(acc, node_parent)) next_all_leaves.insert(acc, node_parent);
+    }
 
-            //             }
+    public:
 
-            //         } else {
+    IPTrie() { 
+        
+        p_output = make_shared<PktMetaDataArrayOutputQueue >();
+        
+    }
 
-            //             if (node->aggr_len != 0) { 
-                            
-            //                 shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                                
-            //                 if (p_output) p_output->push(p0);
+    IPTrie(uint32_t b, uint64_t a, uint32_t t,
+            shared_ptr<PktMetaDataArrayOutputQueue > p_o, const volatile bool * p_a = nullptr) : 
+                 bound_prefix_length(b), aggr_len_th(a), trunc_flow_len(t), p_output(p_o), p_output_abort(p_a) { 
+        
+        bound_prefix_mask = prefix_mask(bound_prefix_length);
+        
+    }
 
-            //                 sem_wait(&semaphore);
-            //                 curr_aggr_pkt_len += node->aggr_vol;
-            //                 sem_post(&semaphore);
-                            
-            //             }
+    // 预留arena容量, 通常为每个aggr_cycle的流数量的两倍(叶子节点与分叉节点)
+    void reserve(size_t flow_num) { nodes.reserve(flow_num * 2); }
 
-            //         }
+    // 释放全部节点, arena保留容量以供复用
+    void reset() { nodes.clear(); path2bound.clear(); garbage_num = 0; }
 
-            //     });
-            
-            // };
+    size_t node_num() const { return nodes.size(); }
+    size_t bound_num() const { return path2bound.size(); }
 
-            // try {
+    void insert(const uint32_t & ip, const FlowDataStats & _stats, double_t ts = 0) {
 
-            //     tbb::parallel_invoke(
-            //         [&]() { aggr_left_leaves(); },
-            //         [&]() { aggr_right_leaves(); }
-            //     );
+        // 更新当前节点的mts
+        TrieNode & node = nodes[locate_leaf(ip, ts)];
 
-            // } catch (const std::exception& e) {
-                
-            //     std::cerr << "Error during aggr leaves: " << e.what() << std::endl;
-            
-            // }
+        if (node.aggr_len < trunc_flow_len) node.aggr_flow.insert(_stats.p_flat_vec);
 
-            for (const auto & node : next_all_leaves) {
+        node.aggr_len += _stats.len;
+        node.aggr_vol += _stats.vol;
 
-                if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
-               
-                    if (node->type == 0) { 
-                        
-                        // 不论当前左节点的右兄弟情况如何, 当前左节点加入next_left_leaves
-                        next_left_leaves.insert(node);
-                    
-                    } else if (node->type == 1) {
-                        
-                        shared_ptr<TrieNode > sibling = node_parent->children[0];
+    }
 
-                        // sibling && !sibling-is_end代表聚合没有进行到当前右节点的左兄弟, 当前右节点可以加入next_right_leaves
-                        // !sibling代表当前右节点本身没有左兄弟
-                        if ((sibling && !sibling->is_end) || !sibling) {
-                            
-                            next_right_leaves.insert(node);
+    // 吸收另一棵(尚未聚合的)IPTrie的所有叶子数据, 之后delta只能reset()
+    void absorb(IPTrie & delta, double_t ts) {
 
-                        }
+        for (auto & leaf : delta.nodes) {
 
-                    }
+            if (leaf.prefix_len != 32 || leaf.aggr_len == 0) continue;
 
-                } else {
+            TrieNode & node = nodes[locate_leaf(leaf.prefix, ts)];
 
-                    // 聚合至aggr_bound的节点不会加入至next_all_leaves
-                    // 当前节点已经位于aggr_bound, 直接向output添加聚合的结果
-                    if (node->aggr_len != 0) { 
-                        
-                        shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                                
-                        if (p_output) p_output->push(p0);
+            if (node.aggr_len < trunc_flow_len) node.aggr_flow.absorb(move(leaf.aggr_flow));
 
-                        curr_aggr_pkt_len += node->aggr_vol;
-                    
-                    }
+            node.aggr_len += leaf.aggr_len;
+            node.aggr_vol += leaf.aggr_vol;
 
-                }
+        }
 
-            }
+    }
 
-            // auto add2leaves = [&, this] (const shared_ptr<TrieNode > & node) -> void {
+    // 批量模式: 聚合所有bound并发送全部数据
+    uint64_t aggregate(tbb::task_arena * p_arena = nullptr) {
 
-            //     if (shared_ptr<TrieNode > node_parent = node->parent.lock()) {
-               
-            //         if (node->type == 0) { 
-                        
-            //             // 不论当前左节点的右兄弟情况如何, 当前左节点加入next_left_leaves
-            //             IPTrieLeaves::accessor l_acc;
-            //             if (!next_left_leaves.find(l_acc, node)) next_left_leaves.insert(l_acc, node);
-                    
-            //         } else if (node->type == 1) {
-                        
-            //             shared_ptr<TrieNode > sibling = node_parent->children[0];
+        vector<trie_node_idx_t > bounds;
+        bounds.reserve(path2bound.size());
 
-            //             // sibling && !sibling-is_end代表聚合没有进行到当前右节点的左兄弟, 当前右节点可以加入next_right_leaves
-            //             // !sibling代表当前右节点本身没有左兄弟
-            //             if ((sibling && !sibling->is_end) || !sibling) {
-                            
-            //                 IPTrieLeaves::accessor r_acc;
-            //                 if (!next_right_leaves.find(r_acc, node)) next_right_leaves.insert(r_acc, node);
+        for (const auto & bound : path2bound) bounds.push_back(bound.second.root);
 
-            //             }
+        return run_bounds(bounds, true, false, p_arena);
 
-            //         }
+    }
 
-            //     } else {
+    // 增量模式: 只重新聚合上次之后有新流插入的bound, 未达到阈值的数据继续保留
+    // 超过prefix_ttl秒没有更新的bound发送剩余数据后删除
+    uint64_t aggregate_incremental(double_t now, double_t prefix_ttl, tbb::task_arena * p_arena = nullptr) {
 
-            //         // 聚合至aggr_bound的节点不会加入至next_all_leaves
-            //         // 当前节点已经位于aggr_bound, 直接向output添加聚合的结果
-            //         if (node->aggr_len != 0) { 
-                        
-            //             shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(node->aggr_flow.get_mts(), node->aggr_vol);
-                                
-            //             if (p_output) p_output->push(p0);
-                        
-            //             sem_wait(&semaphore);
-            //             curr_aggr_pkt_len += node->aggr_vol;
-            //             sem_post(&semaphore);
-                    
-            //         }
+        vector<trie_node_idx_t > dirty_bounds, stale_bounds;
+        vector<uint32_t > stale_prefixes;
 
-            //     }
+        for (auto & bound : path2bound) {
 
-            // };
+            if (now - bound.second.last_update_ts >= prefix_ttl) {
 
-            // tbb::parallel_for_each(next_all_leaves.begin(), next_all_leaves.end(), [&] (auto && item) {
+                stale_bounds.push_back(bound.second.root);
+                stale_prefixes.push_back(bound.first);
 
-            //     shared_ptr<TrieNode > node = item.first;
-            //     add2leaves(node);
+            } else if (bound.second.dirty) {
 
-            // });
+                dirty_bounds.push_back(bound.second.root);
+                bound.second.dirty = false;
 
-            // 移动语义, 资源转移, 不会增加shared_ptr中的引用计数
-            left_leaves = move(next_left_leaves);
-            right_leaves = move(next_right_leaves);
+            }
 
         }
 
+        uint64_t curr_aggr_pkt_len = run_bounds(dirty_bounds, false, true, p_arena);
+        curr_aggr_pkt_len += run_bounds(stale_bounds, true, true, p_arena);
+
+        for (size_t i = 0; i < stale_prefixes.size(); i ++) {
+
+            garbage_num += subtree_size(stale_bounds[i]);
+            path2bound.erase(stale_prefixes[i]);
+
+        }
+
+        if (garbage_num * 2 > nodes.size()) compact();
+
         return curr_aggr_pkt_len;
 
     }
@@ -13,7 +13,7 @@ static inline double_t __get_double_ts() {
 
 bool InspectorWorkerThread::run(uint32_t coreId) {
 
-	if (p_assembler_vec.size() == 0) {
+	if (p_assembler_vec.size() == 0 && p_steal_assembler_vec.size() == 0) {
 
         WARN("No Assemblers are Bound to Current Inspector.");
         
@@ -26,173 +26,185 @@ bool InspectorWorkerThread::run(uint32_t coreId) {
 	m_stop = false;
 	m_core_id = coreId;
 
-	unique_ptr<vector<FlowID > > last_pool;
-    uint64_t snapshot_ts;
+	// arena并发度 = 1个master slot(inspector lcore自身) + arena_cores上的worker线程
+	// 不再使用TBB全局线程池, 避免worker线程漂移到parser/assembler核心上
+	p_arena = make_unique<tbb::task_arena >(static_cast<int >(arena_core_set.size()) + 1, 1);
+	p_arena->initialize();
 
-    auto inspect_pool = [&] (const auto & pool, auto & flow_tbl) -> void {
+	if (!arena_core_set.empty()) {
 
-        if (!pool || !next_historical_pool) return;
+		p_arena_observer = make_unique<CorePinningObserver >(*p_arena, arena_core_set);
 
-        tbb::parallel_for_each(pool->begin(), pool->end(), [&] (const FlowID & _id) {
+	}
 
-            FlowTable::accessor acc;
+    while (!m_stop) {
 
-            if (flow_tbl.find(acc, _id)) {
+        bool local_busy = false;
 
-                FlowEntry _entry = acc->second;
+        for (size_t i = 0; i < p_assembler_vec.size(); i ++) {
 
-                if ((_entry.dirs[0].last_ts <= snapshot_ts && (snapshot_ts - _entry.dirs[0].last_ts >= p_inspector_param->idle_time_out)) || 
-                                                                snapshot_ts - _entry.dirs[0].first_ts >= p_inspector_param->hard_time_out) {
+            if (inspect_assembler(p_assembler_vec[i])) local_busy = true;
 
-                    // 当前流已经完成, 从流表中驱逐
-                    flow_tbl.erase(acc); 
+        }
 
-                    // 长短流分类
-                    if (_entry.dirs[0].len >= p_inspector_param->long_th) { 
-                        
-                        shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(_entry.dirs[0].p_flat_vec, _entry.dirs[0].vol);
+        if (local_busy || p_steal_assembler_vec.empty()) continue;
 
-                        long_queue.push(p0); 
-                    
-                    } else { 
-                        
-                        short_flow_queue.push({_id, move(_entry)}); 
-                    
-                    }
+        // 本地assemblers没有待检查的轮次, 轮流从其他assemblers窃取一轮
+        for (size_t k = 0; k < p_steal_assembler_vec.size(); k ++) {
 
-                } else {
+            const size_t victim = (steal_next + k) % p_steal_assembler_vec.size();
 
-                    next_historical_pool->insert(_id);
+            if (inspect_assembler(p_steal_assembler_vec[victim])) {
 
-                }
+                stolen_rounds.fetch_add(1, memory_order_relaxed);
+                steal_next = victim + 1;
 
-            }
+                break;
 
-        });
+            }
 
-    };
+        }
 
-    while (!m_stop) {
+    }
 
-        next_historical_pool = make_unique<tbb::concurrent_unordered_set<FlowID, FlowIDHash > >();
 
-        // next_historical_pool = make_unique<unordered_set<FlowID, FlowIDHash > >();
+	return true;
 
-        // for (size_t i = 0; i < p_assembler_vec.size(); i ++) {
+}
 
-        //     if (p_assembler_vec[i]->last_pool_queue.try_pop(last_pool) && p_assembler_vec[i]->snapshot_ts_queue.try_pop(snapshot_ts)) {
+void InspectorWorkerThread::route_short_flow(uint32_t ip, FlowDataStats & _stats, uint32_t flow_class) {
 
-        //         for (const auto & _id : *last_pool) {
+	if (p_short_flow_queue_vec.empty()) return;
 
-        //             FlowTable::accessor acc;
+	const size_t _k = bound_prefix_partition(ip, aggr_bound_prefix_mask, p_short_flow_queue_vec.size());
 
-        //             if (p_assembler_vec[i]->flow_tbl.find(acc, _id)) {
+	p_short_flow_queue_vec[_k]->push({ip, move(_stats)}, flow_class, &m_stop);
 
-        //                 FlowEntry _entry = acc->second;
+}
 
-        //                 if ((_entry.dirs[0].last_ts <= snapshot_ts && (snapshot_ts - _entry.dirs[0].last_ts >= p_inspector_param->idle_time_out)) || 
-        //                                                                 snapshot_ts - _entry.dirs[0].first_ts >= p_inspector_param->hard_time_out) {
+bool InspectorWorkerThread::inspect_assembler(const shared_ptr<AssemblerWorkerThread > & p_assembler) {
 
-        //                     // 当前流已经完成, 从流表中驱逐
-        //                     p_assembler_vec[i]->flow_tbl.erase(acc); 
+    // 同一时刻只有一个inspector能够检查某个assembler, 其historical_pool不会被并发替换
+    bool expected = false;
 
-        //                     // 长短流分类
-        //                     if (_entry.dirs[0].len >= p_inspector_param->long_th) { 
-                                
-        //                         shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(_entry.dirs[0].p_flat_vec, _entry.dirs[0].vol);
+    if (!p_assembler->inspecting.compare_exchange_strong(expected, true, memory_order_acquire)) return false;
 
-        //                         long_queue.push(p0); 
-                            
-        //                     } else { 
-                                
-        //                         short_flow_queue.push({_id, move(_entry)}); 
-                            
-        //                     }
+    pair<unique_ptr<vector<FlowID > >, uint64_t > last_pool_item;
 
-        //                 } else {
+    if (!p_assembler->last_pool_queue.try_pop(last_pool_item)) {
 
-        //                     next_historical_pool->insert(_id);
+        p_assembler->inspecting.store(false, memory_order_release);
 
-        //                 }
+        return false;
 
-        //             }
+    }
 
-        //         }
+    const unique_ptr<vector<FlowID > > & last_pool = last_pool_item.first;
+    const uint64_t snapshot_ts = last_pool_item.second;
 
-        //         for (const auto & _id : *historical_pool) {
+    FlowTable & flow_tbl = p_assembler->flow_tbl;
 
-        //             FlowTable::accessor acc;
+    unique_ptr<tbb::concurrent_unordered_set<FlowID, FlowIDHash > > next_historical_pool = make_unique<tbb::concurrent_unordered_set<FlowID, FlowIDHash > >();
 
-        //             if (p_assembler_vec[i]->flow_tbl.find(acc, _id)) {
+    auto inspect_pool = [&] (const auto & pool) -> void {
 
-        //                 FlowEntry _entry = acc->second;
+        if (!pool) return;
 
-        //                 if ((_entry.dirs[0].last_ts <= snapshot_ts && (snapshot_ts - _entry.dirs[0].last_ts >= p_inspector_param->idle_time_out)) || 
-        //                                                                 snapshot_ts - _entry.dirs[0].first_ts >= p_inspector_param->hard_time_out) {
+        tbb::parallel_for_each(pool->begin(), pool->end(), [&] (const FlowID & _id) {
 
-        //                     // 当前流已经完成, 从流表中驱逐
-        //                     p_assembler_vec[i]->flow_tbl.erase(acc); 
+            FlowTable::accessor acc;
 
-        //                     // 长短流分类
-        //                     if (_entry.dirs[0].len >= p_inspector_param->long_th) { 
-                                
-        //                         shared_ptr<PktMetaDataArrayOutput > p0 = make_shared<PktMetaDataArrayOutput >(_entry.dirs[0].p_flat_vec, _entry.dirs[0].vol);
+            if (flow_tbl.find(acc, _id)) {
 
-        //                         long_queue.push(p0); 
-                            
-        //                     } else { 
-                                
-        //                         short_flow_queue.push({_id, move(_entry)}); 
-                            
-        //                     }
+                FlowEntry _entry = acc->second;
 
-        //                 } else {
+                if ((_entry.dirs[0].last_ts <= snapshot_ts && (snapshot_ts - _entry.dirs[0].last_ts >= p_inspector_param->idle_time_out)) || 
+                                                                snapshot_ts - _entry.dirs[0].first_ts >= p_inspector_param->hard_time_out) {
 
-        //                     next_historical_pool->insert(_id);
+                    // 当前流已经完成, 从流表中驱逐
+                    flow_tbl.erase(acc); 
 
-        //                 }
+                    if (_entry.early_emitted) {
 
-        //             }
+                        // assembler已经提前处理了该流, 只需驱逐
+                        early_emitted_expired_num ++;
 
-        //         }
+                        return;
 
-        //     } 
+                    }
 
-        // }     
+                    // 按分类表决定流的去向与模型
+                    const size_t class_id = p_flow_classifier->classify(_id, _entry.dirs[0]);
+                    const FlowClassRule & rule = p_flow_classifier->get_rule(class_id);
 
-        // historical_pool = move(next_historical_pool);       
+                    p_flow_classifier->record(class_id, _entry.dirs[0].vol);
 
-        // usleep(50000);
+                    if (rule.dest == FlowDestination::LONG && _entry.streamed && !p_stream_queue_vec.empty()) {
 
-        for (size_t i = 0; i < p_assembler_vec.size(); i ++) {
+                        push_stream_chunk(p_stream_queue_vec, _id, _entry.dirs[0], rule.model, true, &m_stop);
 
-            if (p_assembler_vec[i]->last_pool_queue.try_pop(last_pool) && p_assembler_vec[i]->snapshot_ts_queue.try_pop(snapshot_ts)) {
+                    } else if (rule.dest == FlowDestination::LONG) { 
+                        
+                        long_output_ets.local()[flow_class_of(_id)].push_back(make_shared<PktMetaDataArrayOutput >(_entry.dirs[0].p_flat_vec, _entry.dirs[0].vol, rule.model, mts_key_of(_id)));
+                    
+                    } else if (rule.dest == FlowDestination::SHORT) { 
+                        
+                        if (_entry.forward_init) route_short_flow(_id.low_ip, _entry.dirs[1], flow_class_of(_id));
+                        if (_entry.backward_init) route_short_flow(_id.high_ip, _entry.dirs[2], flow_class_of(_id));
+                    
+                    }
 
-                next_historical_pool = make_unique<tbb::concurrent_unordered_set<FlowID, FlowIDHash > >();
-                
-                try {
+                } else {
 
-                    tbb::parallel_invoke(
-                        [&]() { inspect_pool(historical_pool, p_assembler_vec[i]->flow_tbl); },
-                        [&]() { inspect_pool(last_pool, p_assembler_vec[i]->flow_tbl); }
-                    );
+                    next_historical_pool->insert(_id);
 
-                } catch (const std::exception& e) {
-                    
-                    std::cerr << "Error during pool inspection: " << e.what() << std::endl;
-                
                 }
 
-            } 
+            }
+
+        });
+
+    };
+
+    try {
+
+        p_arena->execute([&]() {
 
-            historical_pool = move(next_historical_pool);
+            tbb::parallel_invoke(
+                [&]() { inspect_pool(p_assembler->historical_pool); },
+                [&]() { inspect_pool(last_pool); }
+            );
+
+        });
+
+    } catch (const std::exception& e) {
+        
+        std::cerr << "Error during pool inspection: " << e.what() << std::endl;
+    
+    }
+
+    // 过期的长流按类别整批写入共享的long工作队列
+    for (auto & _local : long_output_ets) {
+
+        for (uint32_t _c = 0; _c < _local.size(); _c ++) {
+
+            if (_local[_c].empty()) continue;
+
+            p_long_queue->push_bulk(_local[_c], _c, &m_stop);
+            _local[_c].clear();
 
         }
 
     }
 
+    // 未过期的流留在该assembler自身的historical_pool中, 下一轮继续由其流表检查
+    p_assembler->historical_pool = move(next_historical_pool);
 
-	return true;
+    inspect_rounds.fetch_add(1, memory_order_relaxed);
+
+    p_assembler->inspecting.store(false, memory_order_release);
+
+    return true;
 
 }
 
@@ -200,6 +212,8 @@ bool InspectorWorkerThread::run(uint32_t coreId) {
 void InspectorWorkerThread::stop() {
 
 	LOGF("Inspector on Core #%d Stop", m_core_id);
+	LOGF("Inspector on Core #%d: %ld Inspection Rounds (%ld Stolen), %ld Early Emitted Flows Expired", m_core_id, inspect_rounds.load(), stolen_rounds.load(), early_emitted_expired_num.load());
+	p_flow_classifier->display_stats();
 	
 	m_stop = true;
 	
@@ -248,6 +262,15 @@ void InspectorWorkerThread::load_params_via_json(const json &jin) {
         } else {
             FATAL_ERROR("Parameter(long_th) is Missing!");
         }
+
+        if (jin.count("arena_cores")) {
+            const vector<int> & core_vec = jin["arena_cores"];
+            p_inspector_param->arena_cores.assign(core_vec.cbegin(), core_vec.cend());
+        }
+
+        p_flow_classifier->load_params_via_json(jin.count("flow_classes") ? jin["flow_classes"] : json::array(), p_inspector_param->long_th);
+
+        if (jin.count("long_queue")) p_inspector_param->long_queue_param.load_params_via_json(jin["long_queue"]);
     
     
     } catch (exception & e) {
@@ -256,6 +279,8 @@ void InspectorWorkerThread::load_params_via_json(const json &jin) {
     
     }
 
+    p_long_queue->configure(p_inspector_param->long_queue_param, &m_stop);
+
 	return;
 
 }
\ No newline at end of file
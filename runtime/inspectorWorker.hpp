@@ -24,6 +24,13 @@ struct InspectorThreadParam final {
     uint32_t trunc_flow_len = 1e3;
     uint32_t long_th = 40;
 
+    // TBB worker threads of the inspection arenas are pinned to these cores, split evenly among inspectors
+    // (empty -> inspection runs inline on the inspector lcore)
+    vector<cpu_core_id_t > arena_cores;
+
+    // bounded queue towards detectors (short flows go to the aggregator-owned short_flow_queue)
+    BoundedQueueParam long_queue_param = BoundedQueueParam(1 << 16, OverloadPolicy::SHED_NEWEST);
+
 
     void inline display_params() const {
 
@@ -36,6 +43,15 @@ struct InspectorThreadParam final {
         printf("Truncation Length for Flow: %d.\n", trunc_flow_len);
         printf("Long Flow Threshold: %d.\n", long_th);
 
+        if (arena_cores.empty()) printf("Inspection Arena is Inline (No TBB Worker Threads).\n");
+        else {
+            printf("Inspection Arena is Pinned to Cores:");
+            for (const auto & _core : arena_cores) printf(" %d", _core);
+            printf(".\n");
+        }
+
+        long_queue_param.display_params("long_queue");
+
     }
 
 };
@@ -57,31 +73,86 @@ private:
     // 与inspector关联的一系列assemblers
     vector<shared_ptr<AssemblerWorkerThread > > p_assembler_vec;
 
-    unique_ptr<tbb::concurrent_unordered_set<FlowID, FlowIDHash > > historical_pool;
-    unique_ptr<tbb::concurrent_unordered_set<FlowID, FlowIDHash > > next_historical_pool;
+    // 其余的assemblers, 本地assemblers空闲时从中窃取检查轮次
+    vector<shared_ptr<AssemblerWorkerThread > > p_steal_assembler_vec;
+    size_t steal_next = 0;
+
+    // 本inspector的arena worker线程可用的核心, 由ConfigReaper从arena_cores中划分
+    vector<cpu_core_id_t > arena_core_set;
+
+    // 由inspector线程更新, 在master线程的stop()中读取
+    atomic<uint64_t > inspect_rounds{0};
+    atomic<uint64_t > stolen_rounds{0};
+    atomic<uint64_t > early_emitted_expired_num{0};
 
-    // unique_ptr<unordered_set<FlowID, FlowIDHash > > historical_pool;
-    // unique_ptr<unordered_set<FlowID, FlowIDHash > > next_historical_pool;
+    // 并行检查流表所使用的task_arena, worker线程绑定至arena_core_set
+    unique_ptr<tbb::task_arena > p_arena;
+    unique_ptr<CorePinningObserver > p_arena_observer;
+
+    // 认领并执行某个assembler的一轮过期检查, 没有待检查的轮次或已被其他inspector认领时返回false
+    bool inspect_assembler(const shared_ptr<AssemblerWorkerThread > & p_assembler);
 
     // inspector <-> aggregator
-    tbb::concurrent_queue<pair<FlowID, FlowEntry > > short_flow_queue;
+    // 每个aggregator拥有一个short_flow_queue, 短流的每个方向按bound prefix的散列写入对应的队列
+    vector<shared_ptr<ShortFlowQueue > > p_short_flow_queue_vec;
+    uint32_t aggr_bound_prefix_mask = 0xffffff00;
+
+    void route_short_flow(uint32_t ip, FlowDataStats & _stats, uint32_t flow_class);
+
+    // inspector/assembler <-> detector
+    // 运行时由ConfigReaper替换为所有inspectors/assemblers共享的long工作队列
+    shared_ptr<PktMetaDataArrayOutputQueue > p_long_queue;
 
-    // inspector <-> detector (set by detector)
-    tbb::concurrent_queue<shared_ptr<PktMetaDataArrayOutput > > long_queue;
+    // 一轮检查中各worker线程按流类别暂存的过期长流, 检查结束后整批写入p_long_queue
+    tbb::enumerable_thread_specific<array<vector<shared_ptr<PktMetaDataArrayOutput > >, 3> > long_output_ets;
+
+    // 每个detector一个流式分段队列 (set by ConfigReaper), 已分段发送的长流过期时, 最后一段写入负责该流的detector
+    vector<shared_ptr<PktMetaDataArrayOutputQueue > > p_stream_queue_vec;
+
+    // 流分类表, 与本地assemblers共用 (提前发送时同样需要分类)
+    shared_ptr<FlowClassifier > p_flow_classifier;
 
 
 public:
 
-    InspectorWorkerThread(const vector<shared_ptr<AssemblerWorkerThread > > & _pv): p_assembler_vec(_pv) {
+    // _pv: 本地assemblers, _av: 所有assemblers (用于work-stealing)
+    InspectorWorkerThread(const vector<shared_ptr<AssemblerWorkerThread > > & _pv, 
+                            const vector<shared_ptr<AssemblerWorkerThread > > & _av): p_assembler_vec(_pv) {
+
+        p_long_queue = make_shared<PktMetaDataArrayOutputQueue >();
+        p_flow_classifier = make_shared<FlowClassifier >();
+
+        set_steal_assembler_vec(_av);
 
     }
 
-    InspectorWorkerThread(const vector<shared_ptr<AssemblerWorkerThread > > & _pv, const json & _j): p_assembler_vec(_pv) {
+    InspectorWorkerThread(const vector<shared_ptr<AssemblerWorkerThread > > & _pv, 
+                            const vector<shared_ptr<AssemblerWorkerThread > > & _av, 
+                            const json & _j): p_assembler_vec(_pv) {
+
+        p_long_queue = make_shared<PktMetaDataArrayOutputQueue >();
+        p_flow_classifier = make_shared<FlowClassifier >();
+
+        set_steal_assembler_vec(_av);
 
         load_params_via_json(_j);
 
     }
 
+    void set_steal_assembler_vec(const vector<shared_ptr<AssemblerWorkerThread > > & _av) {
+
+        for (const auto & p_assembler : _av) {
+
+            if (find(p_assembler_vec.cbegin(), p_assembler_vec.cend(), p_assembler) == p_assembler_vec.cend()) {
+
+                p_steal_assembler_vec.push_back(p_assembler);
+
+            }
+
+        }
+
+    }
+
     virtual bool run(uint32_t coreId) override;
 
     virtual void stop() override;
@@ -0,0 +1,246 @@
+#include "verdictSink.hpp"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+
+using namespace Reaper;
+
+SPSCRing<Verdict > * VerdictSink::add_producer() {
+
+	if (running.load()) {
+
+		FATAL_ERROR("Producers of Verdict Sink Must be Added before Starting.");
+
+	}
+
+	ring_vec.push_back(make_unique<SPSCRing<Verdict > >(param.ring_capacity));
+
+	return ring_vec.back().get();
+
+}
+
+void VerdictSink::open_output() {
+
+	if (param.type == VerdictSinkType::BINARY || param.type == VerdictSinkType::JSONL) {
+
+		p_file = fopen(param.path.c_str(), param.type == VerdictSinkType::BINARY ? "ab" : "a");
+
+		if (p_file == nullptr) FATAL_ERROR("Fail to Open Verdict File " + param.path + ".");
+
+	} else if (param.type == VerdictSinkType::SHM) {
+
+		size_t capacity = 1;
+		while (capacity < param.shm_capacity) capacity <<= 1;
+
+		shm_size = sizeof(VerdictShmHeader) + capacity * sizeof(Verdict);
+
+		shm_fd = shm_open(param.path.c_str(), O_CREAT | O_RDWR, 0644);
+
+		if (shm_fd < 0 || ftruncate(shm_fd, shm_size) != 0) FATAL_ERROR("Fail to Create Shared Memory " + param.path + " for Verdicts.");
+
+		void * p_base = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+
+		if (p_base == MAP_FAILED) FATAL_ERROR("Fail to Map Shared Memory " + param.path + " for Verdicts.");
+
+		p_shm_header = static_cast<VerdictShmHeader * >(p_base);
+		p_shm_records = reinterpret_cast<Verdict * >(p_shm_header + 1);
+
+		// 每次启动都重新开始, 消费者以magic判断头部是否已就绪
+		p_shm_header->magic = 0;
+		p_shm_header->version = 1;
+		p_shm_header->record_size = sizeof(Verdict);
+		p_shm_header->capacity = capacity;
+		new (&p_shm_header->write_idx) atomic<uint64_t >(0);
+		new (&p_shm_header->read_idx) atomic<uint64_t >(0);
+		atomic_thread_fence(memory_order_release);
+		p_shm_header->magic = VerdictShmHeader::MAGIC;
+
+	}
+
+}
+
+void VerdictSink::close_output() {
+
+	if (p_file) {
+		fclose(p_file);
+		p_file = nullptr;
+	}
+
+	if (p_shm_header) {
+		munmap(p_shm_header, shm_size);
+		p_shm_header = nullptr;
+		p_shm_records = nullptr;
+	}
+
+	if (shm_fd >= 0) {
+		close(shm_fd);
+		shm_fd = -1;
+	}
+
+}
+
+void VerdictSink::start() {
+
+	if (param.type == VerdictSinkType::NONE || running.load()) return;
+
+	open_output();
+
+	running.store(true);
+	sink_thread = thread(&VerdictSink::sink_loop, this);
+
+	LOGF("Verdict Sink Start (%ld Producers).", ring_vec.size());
+
+}
+
+void VerdictSink::stop() {
+
+	if (!running.exchange(false)) return;
+
+	if (sink_thread.joinable()) sink_thread.join();
+
+	close_output();
+
+	LOGF("Verdict Sink Stop.");
+
+}
+
+void VerdictSink::write_records(const Verdict * verdicts, size_t n) {
+
+	const double_t curr_ts = get_time_spec();
+
+	size_t written = n;
+
+	switch (param.type) {
+
+		case VerdictSinkType::BINARY:
+
+			written = fwrite(verdicts, sizeof(Verdict), n, p_file);
+
+			break;
+
+		case VerdictSinkType::JSONL:
+
+			for (size_t i = 0; i < n; i ++) {
+
+				const Verdict & v = verdicts[i];
+				const char * model_name[] = {"long", "aggr", "prefilter"};
+				const uint32_t ip0 = v.key.ip0, ip1 = v.key.ip1;
+
+				int ret;
+
+				if (v.key.prefix_len) {
+					ret = fprintf(p_file, "{\"prefix\":\"%u.%u.%u.%u/%u\"", ip0 >> 24, (ip0 >> 16) & 0xff, (ip0 >> 8) & 0xff, ip0 & 0xff, v.key.prefix_len);
+				} else {
+					ret = fprintf(p_file, "{\"ip0\":\"%u.%u.%u.%u\",\"port0\":%u,\"ip1\":\"%u.%u.%u.%u\",\"port1\":%u,\"proto\":%u",
+									ip0 >> 24, (ip0 >> 16) & 0xff, (ip0 >> 8) & 0xff, ip0 & 0xff, v.key.port0,
+									ip1 >> 24, (ip1 >> 16) & 0xff, (ip1 >> 8) & 0xff, ip1 & 0xff, v.key.port1, v.key.proto);
+				}
+
+				if (ret >= 0) ret = fprintf(p_file, ",\"score\":%.6g,\"first_ts\":%lu,\"last_ts\":%lu,\"pkts\":%u,\"model\":\"%s\",\"detect_ts\":%lu}\n",
+												v.score, v.first_ts, v.last_ts, v.pkt_num, model_name[min<uint8_t >(v.model, 2)], v.detect_ts);
+
+				if (ret < 0) written --;
+
+			}
+
+			break;
+
+		case VerdictSinkType::SHM: {
+
+			const uint64_t _w = p_shm_header->write_idx.load(memory_order_relaxed);
+			const uint64_t _free = p_shm_header->capacity - (_w - p_shm_header->read_idx.load(memory_order_acquire));
+
+			written = min(static_cast<size_t >(_free), n);
+
+			for (size_t i = 0; i < written; i ++) p_shm_records[(_w + i) & (p_shm_header->capacity - 1)] = verdicts[i];
+
+			p_shm_header->write_idx.store(_w + written, memory_order_release);
+
+			break;
+
+		}
+
+		case VerdictSinkType::NONE:
+
+			break;
+
+	}
+
+	for (size_t i = 0; i < n; i ++) {
+		const double_t _lag = max(curr_ts - verdicts[i].detect_ts * 1e-9, 0.0);
+		sum_lag += _lag;
+		max_lag = max(max_lag, _lag);
+	}
+
+	written_num.fetch_add(written, memory_order_relaxed);
+	sink_dropped_num.fetch_add(n - written, memory_order_relaxed);
+
+}
+
+void VerdictSink::sink_loop() {
+
+	const size_t BATCH = 256;
+	Verdict verdicts[BATCH];
+
+	double_t last_flush_ts = get_time_spec();
+
+	// 停止后继续写完ring中剩余的结论
+	while (true) {
+
+		const bool stopping = !running.load(memory_order_acquire);
+
+		size_t total = 0;
+
+		for (auto & p_ring : ring_vec) {
+
+			size_t _n;
+
+			while ((_n = p_ring->pop_bulk(verdicts, BATCH)) > 0) {
+				write_records(verdicts, _n);
+				total += _n;
+			}
+
+		}
+
+		const double_t curr_ts = get_time_spec();
+
+		if (p_file && curr_ts - last_flush_ts >= param.flush_interval) {
+			fflush(p_file);
+			last_flush_ts = curr_ts;
+		}
+
+		if (total == 0) {
+
+			if (stopping) break;
+
+			usleep(1000);
+
+		}
+
+	}
+
+	if (p_file) fflush(p_file);
+
+}
+
+void VerdictSink::display_stats() const {
+
+	if (param.type == VerdictSinkType::NONE) return;
+
+	uint64_t ring_dropped_num = 0;
+	size_t backlog = 0;
+
+	for (const auto & p_ring : ring_vec) {
+		ring_dropped_num += p_ring->get_dropped_num();
+		backlog += p_ring->size();
+	}
+
+	const uint64_t _written = written_num.load(memory_order_relaxed);
+	const uint64_t _sink_dropped = sink_dropped_num.load(memory_order_relaxed);
+	const uint64_t _consumed = _written + _sink_dropped;
+
+	printf("Verdict Sink(%s) -> Written: %lu, Dropped: %lu (Ring Full) + %lu (Sink), Backlog: %ld, Lag: Mean %4.4lf ms, Max %4.4lf ms\n",
+			param.path.c_str(), _written, ring_dropped_num, _sink_dropped, backlog,
+			_consumed ? sum_lag / _consumed * 1e3 : 0.0, max_lag * 1e3);
+
+}
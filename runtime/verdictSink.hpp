@@ -0,0 +1,219 @@
+#pragma once
+
+#include "dpdkAppUtility.hpp"
+
+namespace Reaper
+{
+
+// 检测结论 (56字节, 小端), 二进制文件与共享内存ring中的每条记录均为该布局
+struct Verdict {
+
+    MTSKey key;             // 流的五元组或聚合流的IP前缀
+    double_t score = 0;     // 各窗口输出均值的最大值, 或预过滤的得分
+    uint64_t first_ts = 0;  // 参与检测的首个与最后一个数据包的时间戳(ns)
+    uint64_t last_ts = 0;
+    uint64_t detect_ts = 0; // detector给出结论的时间(ns)
+    uint32_t pkt_num = 0;
+    uint8_t model = 0;      // VerdictSource
+    uint8_t reserved[3] = {0, 0, 0};
+
+};
+
+static_assert(sizeof(Verdict) == 56, "Layout of Verdict Records Must Stay Fixed.");
+
+// 给出结论的模型: 与DetectorModel取值一致, 另加预过滤(直接告警的序列)
+enum class VerdictSource : uint8_t { LONG_MODEL = 0, AGGR_MODEL = 1, PREFILTER = 2 };
+
+// 单生产者单消费者的无锁ring: 生产者为一个detector, 消费者为sink线程
+// 满时push直接失败并计数, 生产者从不等待
+template <typename T >
+class SPSCRing final {
+
+    private:
+
+    vector<T > slots;
+    size_t mask;
+
+    // 生产者与消费者各自推进的位置, 分处不同的cache line
+    atomic<uint64_t > head{0};
+    char pad0[64 - sizeof(atomic<uint64_t >)];
+    atomic<uint64_t > tail{0};
+    char pad1[64 - sizeof(atomic<uint64_t >)];
+
+    atomic<uint64_t > dropped_num{0};
+
+    public:
+
+    // 容量向上取整为2的幂
+    explicit SPSCRing(size_t capacity) {
+        size_t _c = 1;
+        while (_c < capacity) _c <<= 1;
+        slots.resize(_c);
+        mask = _c - 1;
+    }
+
+    virtual ~SPSCRing() {}
+    SPSCRing & operator=(const SPSCRing &) = delete;
+    SPSCRing(const SPSCRing &) = delete;
+
+    bool try_push(const T & item) {
+
+        const uint64_t _h = head.load(memory_order_relaxed);
+
+        if (_h - tail.load(memory_order_acquire) > mask) {
+            dropped_num.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        slots[_h & mask] = item;
+        head.store(_h + 1, memory_order_release);
+
+        return true;
+
+    }
+
+    // 最多取出max_num个元素写入out, 返回取出的数量
+    size_t pop_bulk(T * out, size_t max_num) {
+
+        const uint64_t _t = tail.load(memory_order_relaxed);
+        const size_t _n = min(static_cast<size_t >(head.load(memory_order_acquire) - _t), max_num);
+
+        for (size_t i = 0; i < _n; i ++) out[i] = slots[(_t + i) & mask];
+
+        tail.store(_t + _n, memory_order_release);
+
+        return _n;
+
+    }
+
+    size_t size() const { return head.load(memory_order_acquire) - tail.load(memory_order_acquire); }
+    size_t capacity() const { return mask + 1; }
+    uint64_t get_dropped_num() const { return dropped_num.load(memory_order_relaxed); }
+
+};
+
+// 共享内存ring的头部, 之后紧跟capacity条Verdict记录
+// sink推进write_idx, 本地消费者读取[read_idx, write_idx)的记录后推进read_idx; ring满时sink丢弃新记录
+struct VerdictShmHeader {
+
+    static const uint64_t MAGIC = 0x5443494452455652ull; // "RVERDICT"
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    char pad0[40];
+    atomic<uint64_t > write_idx;
+    char pad1[56];
+    atomic<uint64_t > read_idx;
+    char pad2[56];
+
+};
+
+// 结论的去向: 不输出, 追加写入的二进制文件, JSON lines文件, 或共享内存ring
+enum class VerdictSinkType : uint8_t { NONE = 0, BINARY = 1, JSONL = 2, SHM = 3 };
+
+struct VerdictSinkParam final {
+
+    VerdictSinkType type = VerdictSinkType::NONE;
+
+    // 文件路径, 或共享内存对象名(如"/reaper_verdicts")
+    string path = "../verdicts.bin";
+
+    // 每个detector的ring容量, 以及共享内存ring的容量(记录数)
+    size_t ring_capacity = 1 << 16;
+    size_t shm_capacity = 1 << 16;
+
+    // 文件输出的刷新间隔(秒)
+    double_t flush_interval = 0.1;
+
+    void inline display_params() const {
+
+        const char * type_name[] = {"none", "binary", "jsonl", "shm"};
+
+        if (type == VerdictSinkType::NONE) {
+            printf("Verdict Sink is Down.\n");
+            return;
+        }
+
+        printf("Verdict Sink -> Type: %s, Path: %s, Ring Capacity: %ld per Detector", type_name[static_cast<uint8_t >(type)], path.c_str(), ring_capacity);
+        if (type == VerdictSinkType::SHM) printf(", Shared Memory Capacity: %ld", shm_capacity);
+        printf(".\n");
+
+    }
+
+    void load_params_via_json(const json & jin) {
+
+        if (jin.count("type")) {
+            const string & type_name = jin["type"];
+            if (type_name == "none") type = VerdictSinkType::NONE;
+            else if (type_name == "binary") type = VerdictSinkType::BINARY;
+            else if (type_name == "jsonl") type = VerdictSinkType::JSONL;
+            else if (type_name == "shm") type = VerdictSinkType::SHM;
+            else FATAL_ERROR("Parameter(type) of Verdict Sink is Incorrect! (none, binary, jsonl or shm)");
+        }
+
+        if (jin.count("path")) path = static_cast<string >(jin["path"]);
+        if (jin.count("ring_capacity")) ring_capacity = static_cast<size_t >(jin["ring_capacity"]);
+        if (jin.count("shm_capacity")) shm_capacity = static_cast<size_t >(jin["shm_capacity"]);
+        if (jin.count("flush_interval")) flush_interval = static_cast<double_t >(jin["flush_interval"]);
+
+        if (ring_capacity == 0 || shm_capacity == 0) FATAL_ERROR("Capacities of Verdict Sink Must be Positive!");
+
+    }
+
+};
+
+// 结论输出: 每个detector一个SPSCRing, 由独立的sink线程(非DPDK lcore)汇总并写出, detector不做任何I/O
+class VerdictSink final {
+
+    private:
+
+    VerdictSinkParam param;
+
+    vector<unique_ptr<SPSCRing<Verdict > > > ring_vec;
+
+    thread sink_thread;
+    atomic<bool > running{false};
+
+    FILE * p_file = nullptr;
+
+    int shm_fd = -1;
+    size_t shm_size = 0;
+    VerdictShmHeader * p_shm_header = nullptr;
+    Verdict * p_shm_records = nullptr;
+
+    // 以下统计只由sink线程更新
+    atomic<uint64_t > written_num{0};
+    atomic<uint64_t > sink_dropped_num{0}; // 共享内存ring已满或写文件失败
+    double_t sum_lag = 0;  // 结论从给出到写出的延迟(秒)
+    double_t max_lag = 0;
+
+    void open_output();
+    void close_output();
+
+    void sink_loop();
+
+    void write_records(const Verdict * verdicts, size_t n);
+
+public:
+
+    explicit VerdictSink(const VerdictSinkParam & _p): param(_p) {}
+
+    virtual ~VerdictSink() { stop(); }
+    VerdictSink & operator=(const VerdictSink &) = delete;
+    VerdictSink(const VerdictSink &) = delete;
+
+    // 为一个detector创建其私有的ring, 须在start之前调用
+    SPSCRing<Verdict > * add_producer();
+
+    void start();
+
+    // 等待sink线程写完所有ring中剩余的结论后关闭输出, 须在detectors停止之后调用
+    void stop();
+
+    void display_stats() const;
+
+};
+
+}